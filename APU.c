@@ -1,13 +1,15 @@
 #include "APU.h"
-#include "SDL2/SDL.h"
+#include "blip.h"
+#include "frontend.h"
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 
 #define CLOCK_FREQUENCY                                      4194304
-#define FRAME_SEQUENCER_FREQUENCY                                512
-#define SAMPLING_FREQUENCY                                     44100
-#define CYCLES_PER_SAMPLE      (CLOCK_FREQUENCY / SAMPLING_FREQUENCY)    
 
 #define BUFFER_SIZE 1024
+#define AMPLITUDE_SCALE                                           64    // mixed amplitude (-480 -- 480) to 16-bit sample scale
+#define CHANNEL_AMPLITUDE_SCALE                                 2048    // channel DAC output (-15 -- 15) to 16-bit sample scale
 
 /**************************************** CHANNEL 1 - pulse square wave ****************************************/
 struct Channel1
@@ -71,7 +73,7 @@ struct Channel1
 		uint8_t reg;
 	} frequency_high;  // NR14 frequency high register - 0xFF14                         
 
-	uint16_t frequency_timer;                    // 11-bit programmable timer, clocked by system clock @4.194304 MHz divided by 32 (5-bit divider) 
+	int32_t frequency_timer;                     // clock cycles until next waveform step - period (2048 - frequency) x 4
 	uint8_t waveform_generator;
 
 	uint8_t length_counter;                      // 6-bit length counter, clocked by frame sequencer @ 256 Hz
@@ -84,7 +86,7 @@ struct Channel1
 	int sweep_enabled;
 
 	uint8_t digital_output;                      // channel's 4-bit DAC - 16 steps of output voltage (0 -- 15)
-	float DAC;                                   // DAC analog output (-1.0V -- 1.0V)
+	int8_t DAC;                                  // DAC analog output (-15 -- 15 steps of -1.0V -- 1.0V)
 	int DAC_enabled;
 };
 
@@ -137,7 +139,7 @@ struct Channel2
 		uint8_t reg;
 	} frequency_high;  // NR24 frequency high register - 0xFF19   
 
-	uint16_t frequency_timer;                    // 11-bit timer counter, clocked by system clock (@4.194304 MHz) divided by 32 (5-bit divider) 
+	int32_t frequency_timer;                     // clock cycles until next waveform step - period (2048 - frequency) x 4
 	uint8_t waveform_generator;
 
 	uint8_t length_counter;                      // 6-bit length counter, clocked by frame sequencer every 1/256th of a second
@@ -146,7 +148,7 @@ struct Channel2
 	uint8_t volume_sweep_counter;                // 3-bit volume sweep counter
 
 	uint8_t digital_output;                      // channel's 4-bit DAC - 16 steps of output voltage (0 -- 15)
-	float DAC;                                   // DAC analog output (-1.0V -- 1.0V)
+	int8_t DAC;                                  // DAC analog output (-15 -- 15 steps of -1.0V -- 1.0V)
 	int DAC_enabled;
 };
 
@@ -209,7 +211,7 @@ struct Channel3
 		uint8_t reg;
 	} frequency_high;  // NR34 frequency high register  - 0xFF1E
 
-	uint16_t frequency_timer;                    // 11-bit timer counter, clocked by system clock (@4.194304 MHz) divided by 32 (5-bit divider) 
+	int32_t frequency_timer;                     // clock cycles until next wave sample - period (2048 - frequency) x 2
 	
 	uint8_t length_counter;                      // 8-bit length counter, clocked by frame sequencer every 1/256th of a second
 
@@ -218,7 +220,7 @@ struct Channel3
 	uint8_t sample_buffer;                       // current audio sample from wave table RAM
 
 	uint8_t digital_output;                      // channel's 4-bit DAC - 16 steps of output voltage (0 -- 15)
-	float DAC;                                   // DAC analog output (-1.0V -- 1.0V)
+	int8_t DAC;                                  // DAC analog output (-15 -- 15 steps of -1.0V -- 1.0V)
 	int DAC_enabled;
 };
 
@@ -272,7 +274,7 @@ struct Channel4
 		uint8_t reg;
 	} counter_consecutive_initial;  // NR44 counter,consecutive,initial register - 0xFF23
 
-	uint16_t frequency_timer;              // 16-bit timer counter
+	int32_t frequency_timer;               // clock cycles until next LFSR shift - period divisor << shift
 	uint16_t linear_feedback_register;     // 15-bit LFSR (pseudo-random number generator)
 
 	uint8_t length_counter;    // 6-bit length counter, clocked by frame sequencer every 1/256th of a second
@@ -281,7 +283,7 @@ struct Channel4
 	uint8_t volume_sweep_counter;  // 3-bit volume sweep counter
 							   
 	uint8_t digital_output;    // channel's 4-bit DAC - 16 steps of output voltage (0 -- 15)
-	float DAC;                 // DAC analog output (-1.0V -- 1.0V)
+	int8_t DAC;                // DAC analog output (-15 -- 15 steps of -1.0V -- 1.0V)
 	int DAC_enabled;
 };
 
@@ -341,49 +343,77 @@ struct APU
 		uint8_t reg;
 	} sound_controller_on_off;  // NR52 sound controller on/off register - 0xFF26       
 
-	uint64_t clock_cycles;
+	uint8_t frame_sequencer_step;      // 8-step frame sequencer (length counters, sweep, envelopes)
+	uint8_t synthesis;                 // 0: audio disabled - only state the CPU can observe is maintained
 
-	float SO1_output;  // right output terminal
-	float SO2_output;  // left output terminal
+	int SO1_output;  // right output terminal (-480 -- 480)
+	int SO2_output;  // left output terminal (-480 -- 480)
+
+	int8_t DAC_outputs[4];             // channels' DAC outputs last heard - a delta is recorded when one steps
+	uint32_t frame_cycles;             // clock cycles since last APU_end_frame (timestamp of amplitude changes)
+	Blip SO1_blip;                     // band-limited synthesis of right output terminal
+	Blip SO2_blip;                     // band-limited synthesis of left output terminal
+	int16_t samples[BUFFER_SIZE];      // interleaved stereo samples waiting to be handed to the front end
+
+	Blip channel_blips[4];                        // band-limited synthesis of each channel's DAC output (stems)
+	int16_t channel_samples[BUFFER_SIZE * 2];     // interleaved channel 1 -- 4 samples waiting to be handed to the front end
 };
 
 static APU apu;
-static SDL_AudioDeviceID audio_device;
 
-extern void clock(void);
+// channels, registers and frame sequencer (everything before synthesis) - the audio output settings and the
+// synthesis buffers belong to the instance, so output continues from the instance's last level without a click
+static void APU_update_outputs(void);
 
-void audio_callback(void *userdata, uint8_t *stream, int len)
+void APU_state(State *state)
 {
-	for (int i = 0; i < BUFFER_SIZE; i += 2)
-	{
-		for (int j = 0; j < CYCLES_PER_SAMPLE; j += 4)
-			clock(); // @ 1.048576 MHz
-		
-		stream[i] = (apu.SO1_output + 32.0) / 64.0 * 255;
-		stream[i + 1] = (apu.SO2_output + 32.0) / 64.0 * 255;
-	}
+	state_io(state, &apu, offsetof(APU, synthesis));
+
+	if (state->loading)
+		APU_update_outputs();   // step from the instance's last output levels to the loaded ones
+}
+
+/**** channels' frequency timer periods in clock cycles ****/
+static int32_t channel1_period(void)
+{
+	return (2048 - (apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg)) * 4;
+}
+
+static int32_t channel2_period(void)
+{
+	return (2048 - (apu.channel2.frequency_high.bits.frequency_high << 8 | apu.channel2.frequency_low.reg)) * 4;
 }
 
-void APU_init(void)
+static int32_t channel3_period(void)
 {
-	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
-		printf("error initializing audio system: %s", SDL_GetError());
+	return (2048 - (apu.channel3.frequency_high.bits.frequency_high << 8 | apu.channel3.frequency_low.reg)) * 2;
+}
+
+static int32_t channel4_period(void)
+{
+	uint8_t divisor = apu.channel4.polynomial_counter.bits.frequency_divide_ratio;
+
+	return (divisor ? divisor << 4 : 8) << apu.channel4.polynomial_counter.bits.shift_clock_frequency;
+}
 
-	SDL_AudioSpec audio_settings = { 0 };
+void APU_init(uint32_t sampling_frequency)
+{
+	apu.frame_sequencer_step = 0;
+	apu.frame_cycles = 0;
+	memset(apu.DAC_outputs, 0, sizeof apu.DAC_outputs);
+	apu.SO1_output = 0;
+	apu.SO2_output = 0;
 
-	audio_settings.format = AUDIO_U8;
-	audio_settings.freq = SAMPLING_FREQUENCY;
-	audio_settings.channels = 2;  // stereo
- 	audio_settings.samples = BUFFER_SIZE / 2;
-	audio_settings.callback = audio_callback;
-	audio_settings.userdata = NULL;
-	//audio_settings.size;      // calculated
-	//audio_settings.silence;   // calculated
+	apu.synthesis = sampling_frequency != 0;
 
-	if ((audio_device = SDL_OpenAudioDevice(NULL, 0, &audio_settings, NULL, 0)) == 0)
-		printf("error opening audio device: %s", SDL_GetError());
+	if (apu.synthesis)
+	{
+		blip_init(&apu.SO1_blip, CLOCK_FREQUENCY, sampling_frequency);
+		blip_init(&apu.SO2_blip, CLOCK_FREQUENCY, sampling_frequency);
 
-	SDL_PauseAudioDevice(audio_device, 0);
+		for (int i = 0; i < 4; i++)
+			blip_init(&apu.channel_blips[i], CLOCK_FREQUENCY, sampling_frequency);
+	}
 
 	apu.channel1.DAC_enabled = 0;
 	apu.channel2.DAC_enabled = 0;
@@ -394,305 +424,431 @@ void APU_deinit(void)
 
 }
 
-void APU_clock(void)
+// mix channels' DAC outputs to the output terminals after a routing or master volume change
+static void APU_mix(void)
 {
-	// clock channel 1 and 2 frequency timer
-	if (apu.clock_cycles % 4 == 0)
+	if (!apu.synthesis)
+		return;
+
+	int SO1_output = 0;
+	int SO2_output = 0;
+
+	for (int i = 0; i < 4; i++)
 	{
-		// channel 1
-		apu.channel1.frequency_timer--;
+		if (apu.sound_output_terminal_selection.reg >> i & 0x01)         // channel i + 1 to SO1 - right output
+			SO1_output += apu.DAC_outputs[i];
+		if (apu.sound_output_terminal_selection.reg >> (i + 4) & 0x01)   // channel i + 1 to SO2 - left output
+			SO2_output += apu.DAC_outputs[i];
+	}
 
-		if (apu.channel1.frequency_timer == 0)
-		{
-			uint8_t bit0 = apu.channel1.waveform_generator >> 7;
-			apu.channel1.waveform_generator <<= 1;
-			apu.channel1.waveform_generator |= bit0 & 0x01;
-		}
-		else if (apu.channel1.frequency_timer == UINT16_MAX)
-		{
-			uint16_t frequency_timer_reload_value = ~(apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg) + 1 & 0x07FF;
-			apu.channel1.frequency_timer = frequency_timer_reload_value;
-		}
+	SO1_output *= apu.channel_control_on_off_volume.bits.S01_output_level + 1;
+	SO2_output *= apu.channel_control_on_off_volume.bits.S02_output_level + 1;
 
-		// channel 2
-		apu.channel2.frequency_timer--;
+	if (SO1_output != apu.SO1_output)
+	{
+		blip_add_delta(&apu.SO1_blip, apu.frame_cycles, (SO1_output - apu.SO1_output) * AMPLITUDE_SCALE);
+		apu.SO1_output = SO1_output;
+	}
 
-		if (apu.channel2.frequency_timer == 0)
-		{
-			uint8_t bit0 = apu.channel2.waveform_generator >> 7;
-			apu.channel2.waveform_generator <<= 1;
-			apu.channel2.waveform_generator |= bit0 & 0x01;
-		}
-		else if (apu.channel2.frequency_timer == UINT16_MAX)
-		{
-			uint16_t frequency_timer_reload_value = ~(apu.channel2.frequency_high.bits.frequency_high << 8 | apu.channel2.frequency_low.reg) + 1 & 0x07FF;
-			apu.channel2.frequency_timer = frequency_timer_reload_value;
-		}
+	if (SO2_output != apu.SO2_output)
+	{
+		blip_add_delta(&apu.SO2_blip, apu.frame_cycles, (SO2_output - apu.SO2_output) * AMPLITUDE_SCALE);
+		apu.SO2_output = SO2_output;
 	}
+}
 
-	// clock channel 3 frequency timer
-	if (apu.clock_cycles % 2 == 0)
+// record a channel's DAC output step at its clock timestamp, in the output terminals it is routed to and its stem
+static void APU_output(int channel, int8_t DAC, uint32_t time)
+{
+	int delta = DAC - apu.DAC_outputs[channel];
+
+	if (!delta || !apu.synthesis)
+		return;
+
+	apu.DAC_outputs[channel] = DAC;
+
+	if (apu.sound_output_terminal_selection.reg >> channel & 0x01)
 	{
-		apu.channel3.frequency_timer--;
+		int SO1_delta = delta * (apu.channel_control_on_off_volume.bits.S01_output_level + 1);
 
-		if (apu.channel3.frequency_timer == 0)
-		{
-			apu.channel3.position_counter++; // sample num 0 - 31
+		blip_add_delta(&apu.SO1_blip, time, SO1_delta * AMPLITUDE_SCALE);
+		apu.SO1_output += SO1_delta;
+	}
 
-			uint8_t samples = apu.channel3.wave_RAM[apu.channel3.position_counter / 2];
+	if (apu.sound_output_terminal_selection.reg >> (channel + 4) & 0x01)
+	{
+		int SO2_delta = delta * (apu.channel_control_on_off_volume.bits.S02_output_level + 1);
 
-			if (apu.channel3.position_counter % 2)
-				apu.channel3.sample_buffer = samples & 0x0F;
-			else
-				apu.channel3.sample_buffer = samples >> 4 & 0x0F;
+		blip_add_delta(&apu.SO2_blip, time, SO2_delta * AMPLITUDE_SCALE);
+		apu.SO2_output += SO2_delta;
+	}
 
-			apu.channel3.position_counter &= 0x1F;  // wrap around
-		}
-		else if (apu.channel3.frequency_timer == UINT16_MAX)
-		{
-			uint16_t frequency_timer_reload_value = ~(apu.channel3.frequency_high.bits.frequency_high << 8 | apu.channel3.frequency_low.reg) + 1 & 0x07FF;
-			apu.channel3.frequency_timer = frequency_timer_reload_value;
-		}
+	if (frontend.channel_samples)
+		blip_add_delta(&apu.channel_blips[channel], time, delta * CHANNEL_AMPLITUDE_SCALE);
+}
+
+/**** channels' output - recomputed only when the channel's waveform, volume or on flag steps ****/
+static void channel1_output(uint32_t time)
+{
+	if (apu.sound_controller_on_off.bits.channel1_on)
+		apu.channel1.digital_output = (apu.channel1.waveform_generator & 0x01) * apu.channel1.volume;  // 0 -- 15
+	else
+		apu.channel1.digital_output = 0;
+
+	if (apu.channel1.DAC_enabled)
+		apu.channel1.DAC = apu.channel1.digital_output * 2 - 15;   // -1.0V -- 1.0V
+	else
+		apu.channel1.DAC = 0;
+
+	APU_output(0, apu.channel1.DAC, time);
+}
+
+static void channel2_output(uint32_t time)
+{
+	if (apu.sound_controller_on_off.bits.channel2_on)
+		apu.channel2.digital_output = (apu.channel2.waveform_generator & 0x01) * apu.channel2.volume;  // 0 -- 15
+	else
+		apu.channel2.digital_output = 0;
+
+	if (apu.channel2.DAC_enabled)
+		apu.channel2.DAC = apu.channel2.digital_output * 2 - 15;   // -1.0V -- 1.0V
+	else
+		apu.channel2.DAC = 0;
+
+	APU_output(1, apu.channel2.DAC, time);
+}
+
+static void channel3_output(uint32_t time)
+{
+	if (apu.sound_controller_on_off.bits.channel3_on)
+		if (apu.channel3.output_level_select.bits.output_level_select == 0)
+			apu.channel3.digital_output = 0;  // 0 -- 15
+		else
+			apu.channel3.digital_output = apu.channel3.sample_buffer / apu.channel3.output_level_select.bits.output_level_select;
+	else
+		apu.channel3.digital_output = 0;
+
+	if (apu.channel3.DAC_enabled)
+		apu.channel3.DAC = apu.channel3.digital_output * 2 - 15;   // -1.0V -- 1.0V
+	else
+		apu.channel3.DAC = 0;
+
+	APU_output(2, apu.channel3.DAC, time);
+}
+
+static void channel4_output(uint32_t time)
+{
+	if (apu.sound_controller_on_off.bits.channel4_on)
+		apu.channel4.digital_output = (apu.channel4.linear_feedback_register & 0x0001 ? 0 : 1) * apu.channel4.volume;  // 0 -- 15
+	else
+		apu.channel4.digital_output = 0;
+
+	if (apu.channel4.DAC_enabled)
+		apu.channel4.DAC = apu.channel4.digital_output * 2 - 15;   // -1.0V -- 1.0V
+	else
+		apu.channel4.DAC = 0;
+
+	APU_output(3, apu.channel4.DAC, time);
+}
+
+// register writes and frame sequencer events step the outputs at the current clock cycle
+static void APU_update_outputs(void)
+{
+	if (!apu.synthesis)
+		return;
+
+	channel1_output(apu.frame_cycles);
+	channel2_output(apu.frame_cycles);
+	channel3_output(apu.frame_cycles);
+	channel4_output(apu.frame_cycles);
+}
+
+void APU_set_sampling_frequency(double frequency)
+{
+	if (!apu.synthesis)
+		return;
+
+	blip_set_rates(&apu.SO1_blip, CLOCK_FREQUENCY, frequency);
+	blip_set_rates(&apu.SO2_blip, CLOCK_FREQUENCY, frequency);
+
+	for (int i = 0; i < 4; i++)
+		blip_set_rates(&apu.channel_blips[i], CLOCK_FREQUENCY, frequency);
+}
+
+void APU_end_frame(void)
+{
+	if (!apu.synthesis)
+		return;
+
+	blip_end_frame(&apu.SO1_blip, apu.frame_cycles);
+	blip_end_frame(&apu.SO2_blip, apu.frame_cycles);
+
+	if (frontend.channel_samples)
+		for (int i = 0; i < 4; i++)
+			blip_end_frame(&apu.channel_blips[i], apu.frame_cycles);
+
+	apu.frame_cycles = 0;
+
+	// synthesize frame's samples in one batch and hand them to the front end
+	while (blip_samples_avail(&apu.SO1_blip))
+	{
+		int count = blip_read_samples(&apu.SO1_blip, apu.samples, BUFFER_SIZE / 2, 2);   // interleave straight into the output buffer
+		blip_read_samples(&apu.SO2_blip, apu.samples + 1, count, 2);
+
+		if (frontend.audio_samples)
+			frontend.audio_samples(apu.samples, count * 2);
 	}
 
-	// clock channel 4 frequency timer
-	if (apu.clock_cycles % 8 == 0)
+	while (frontend.channel_samples && blip_samples_avail(&apu.channel_blips[0]))
 	{
-		apu.channel4.frequency_timer--;
+		int count = blip_read_samples(&apu.channel_blips[0], apu.channel_samples, BUFFER_SIZE / 2, 4);
 
-		if (apu.channel4.frequency_timer == 0)
-		{
-			uint16_t result_bit = apu.channel4.linear_feedback_register & 0x0001 ^ apu.channel4.linear_feedback_register >> 1 & 0x0001;
-			apu.channel4.linear_feedback_register >>= 1;
-			apu.channel4.linear_feedback_register |= result_bit << 14;
+		for (int i = 1; i < 4; i++)
+			blip_read_samples(&apu.channel_blips[i], apu.channel_samples + i, count, 4);
 
-			if (apu.channel4.polynomial_counter.bits.counter_step_width == 1)
-			{
-				apu.channel4.linear_feedback_register &= ~(1 << 6);
-				apu.channel4.linear_feedback_register |= result_bit << 6;
-			}
-		}
-		else if (apu.channel4.frequency_timer == UINT16_MAX)
-			apu.channel4.frequency_timer = apu.channel4.polynomial_counter.bits.frequency_divide_ratio + 1 << apu.channel4.polynomial_counter.bits.shift_clock_frequency + 1;
+		frontend.channel_samples(apu.channel_samples, count * 4);
 	}
+}
 
-	// clock length counter (channel 1, 2, 3, 4)
-	if (apu.clock_cycles % (CLOCK_FREQUENCY / (FRAME_SEQUENCER_FREQUENCY / 2)) == 0)  // @256 Hz
+// clock length counter (channel 1, 2, 3, 4) @ 256 Hz
+static void APU_clock_length_counters(void)
+{
+	// channel 1
+	if (apu.channel1.frequency_high.bits.counter_enable && apu.channel1.length_counter > 0)
 	{
-		// channel 1
-		if (apu.channel1.frequency_high.bits.counter_enable && apu.channel1.length_counter > 0)
-		{
-			apu.channel1.length_counter--;
+		apu.channel1.length_counter--;
 
-			if (apu.channel1.length_counter == 0)
-				apu.sound_controller_on_off.bits.channel1_on = 0;
-		}
+		if (apu.channel1.length_counter == 0)
+			apu.sound_controller_on_off.bits.channel1_on = 0;
+	}
 
-		// channel 2
-		if (apu.channel2.frequency_high.bits.counter_enable && apu.channel2.length_counter > 0)
-		{
-			apu.channel2.length_counter--;
+	// channel 2
+	if (apu.channel2.frequency_high.bits.counter_enable && apu.channel2.length_counter > 0)
+	{
+		apu.channel2.length_counter--;
 
-			if (apu.channel2.length_counter == 0)
-				apu.sound_controller_on_off.bits.channel2_on = 0;
-		}
+		if (apu.channel2.length_counter == 0)
+			apu.sound_controller_on_off.bits.channel2_on = 0;
+	}
 
-		// channel 3
-		if (apu.channel3.frequency_high.bits.counter_enable && apu.channel3.length_counter > 0)
-		{
-			apu.channel3.length_counter--;
+	// channel 3
+	if (apu.channel3.frequency_high.bits.counter_enable && apu.channel3.length_counter > 0)
+	{
+		apu.channel3.length_counter--;
 
-			if (apu.channel3.length_counter == 0)
-				apu.sound_controller_on_off.bits.channel3_on = 0;
-		}
+		if (apu.channel3.length_counter == 0)
+			apu.sound_controller_on_off.bits.channel3_on = 0;
+	}
 
-		// channel 4
-		if (apu.channel4.counter_consecutive_initial.bits.counter_enable && apu.channel4.length_counter > 0)
-		{
-			apu.channel4.length_counter--;
+	// channel 4
+	if (apu.channel4.counter_consecutive_initial.bits.counter_enable && apu.channel4.length_counter > 0)
+	{
+		apu.channel4.length_counter--;
 
-			if (apu.channel4.length_counter == 0)
-				apu.sound_controller_on_off.bits.channel4_on = 0;
-		}
+		if (apu.channel4.length_counter == 0)
+			apu.sound_controller_on_off.bits.channel4_on = 0;
 	}
+}
 
-	// clock sweep unit (channel 1)
-	if (apu.clock_cycles % (CLOCK_FREQUENCY / (FRAME_SEQUENCER_FREQUENCY / 4)) == 0)  // @128 Hz
+// clock sweep unit (channel 1) @ 128 Hz
+static void APU_clock_sweep(void)
+{
+	if (apu.channel1.sweep_enabled)
 	{
-		if (apu.channel1.sweep_enabled)
+		apu.channel1.sweep_counter--;
+
+		if (apu.channel1.sweep_counter == 0)
 		{
-			apu.channel1.sweep_counter--;
+			apu.channel1.sweep_shadow_frequency_register = apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg;
+			uint16_t shifted_shadow_register = apu.channel1.sweep_shadow_frequency_register >> apu.channel1.sweep_register.bits.sweep_shift;
+			uint16_t new_frequency;
+
+			if (apu.channel1.sweep_register.bits.sweep_direction)  // decrease frequency
+				new_frequency = apu.channel1.sweep_shadow_frequency_register - shifted_shadow_register;
+			else  // increase frequency
+				new_frequency = apu.channel1.sweep_shadow_frequency_register + shifted_shadow_register;
 
-			if (apu.channel1.sweep_counter == 0)
+			if (new_frequency > 2047)  // overflow check
+				apu.sound_controller_on_off.bits.channel1_on = 0;
+			else
 			{
-				apu.channel1.sweep_shadow_frequency_register = apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg;
-				uint16_t shifted_shadow_register = apu.channel1.sweep_shadow_frequency_register >> apu.channel1.sweep_register.bits.sweep_shift;
-				uint16_t new_frequency;
-
-				if (apu.channel1.sweep_register.bits.sweep_direction)  // decrease frequency
-					new_frequency = apu.channel1.sweep_shadow_frequency_register - shifted_shadow_register;
-				else  // increase frequency
-					new_frequency = apu.channel1.sweep_shadow_frequency_register + shifted_shadow_register;
-
-				if (new_frequency > 2047)  // overflow check
-					apu.sound_controller_on_off.bits.channel1_on = 0;
-				else
-				{
-					apu.channel1.sweep_shadow_frequency_register = new_frequency;
-					apu.channel1.frequency_high.bits.frequency_high = new_frequency >> 8 & 0x07;
-					apu.channel1.frequency_low.reg = new_frequency & 0xFF;
-
-					uint16_t frequency_timer_reload_value = ~(apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg) + 1 & 0x07FF;
-					apu.channel1.frequency_timer = frequency_timer_reload_value;
-				}
+				apu.channel1.sweep_shadow_frequency_register = new_frequency;
+				apu.channel1.frequency_high.bits.frequency_high = new_frequency >> 8 & 0x07;
+				apu.channel1.frequency_low.reg = new_frequency & 0xFF;
+
+				apu.channel1.frequency_timer = channel1_period();
 			}
-			else if (apu.channel1.sweep_counter == UINT8_MAX)
-				apu.channel1.sweep_counter = apu.channel1.sweep_register.bits.sweep_period;
 		}
+		else if (apu.channel1.sweep_counter == UINT8_MAX)
+			apu.channel1.sweep_counter = apu.channel1.sweep_register.bits.sweep_period;
 	}
+}
 
-	// clock volume envelope (channel 1, 2, 4)
-	if (apu.clock_cycles % (CLOCK_FREQUENCY / (FRAME_SEQUENCER_FREQUENCY / 8)) == 0)  // @64 Hz
+// clock volume envelope (channel 1, 2, 4) @ 64 Hz
+static void APU_clock_envelopes(void)
+{
+	// channel 1
+	if (apu.channel1.volume_envelope.bits.envelope_period > 0)
 	{
-		// channel 1
-		if (apu.channel1.volume_envelope.bits.envelope_period > 0)
-		{
-			apu.channel1.volume_sweep_counter--;
+		apu.channel1.volume_sweep_counter--;
 
-			if (apu.channel1.volume_sweep_counter == 0)
+		if (apu.channel1.volume_sweep_counter == 0)
+		{
+			if (apu.channel1.volume_envelope.bits.envelope_direction)  // increase volume
 			{
-				if (apu.channel1.volume_envelope.bits.envelope_direction)  // increase volume
-				{
-					if (apu.channel1.volume < 15)
-						apu.channel1.volume++;
-				}
-				else    // decrease volume
-					if (apu.channel1.volume > 0) 
-						apu.channel1.volume--;
+				if (apu.channel1.volume < 15)
+					apu.channel1.volume++;
 			}
-			else if (apu.channel1.volume_sweep_counter == UINT8_MAX)
-				apu.channel1.volume_sweep_counter = apu.channel1.volume_envelope.bits.envelope_period;
+			else    // decrease volume
+				if (apu.channel1.volume > 0) 
+					apu.channel1.volume--;
 		}
+		else if (apu.channel1.volume_sweep_counter == UINT8_MAX)
+			apu.channel1.volume_sweep_counter = apu.channel1.volume_envelope.bits.envelope_period;
+	}
 
-		// channel 2
-		if (apu.channel2.volume_envelope.bits.envelope_period > 0)
-		{
-			apu.channel2.volume_sweep_counter--;
+	// channel 2
+	if (apu.channel2.volume_envelope.bits.envelope_period > 0)
+	{
+		apu.channel2.volume_sweep_counter--;
 
-			if (apu.channel2.volume_sweep_counter == 0)
+		if (apu.channel2.volume_sweep_counter == 0)
+		{
+			if (apu.channel2.volume_envelope.bits.envelope_direction)  // increase volume
 			{
-				if (apu.channel2.volume_envelope.bits.envelope_direction)  // increase volume
-				{
-					if (apu.channel2.volume < 15)
-						apu.channel2.volume++;
-				}
-				else    // decrease volume
-					if (apu.channel2.volume > 0)
-						apu.channel2.volume--;
+				if (apu.channel2.volume < 15)
+					apu.channel2.volume++;
 			}
-			else if (apu.channel2.volume_sweep_counter == UINT8_MAX)
-				apu.channel2.volume_sweep_counter = apu.channel2.volume_envelope.bits.envelope_period;
+			else    // decrease volume
+				if (apu.channel2.volume > 0)
+					apu.channel2.volume--;
 		}
+		else if (apu.channel2.volume_sweep_counter == UINT8_MAX)
+			apu.channel2.volume_sweep_counter = apu.channel2.volume_envelope.bits.envelope_period;
+	}
 
-		// channel 4
-		if (apu.channel4.volume_envelope.bits.envelope_period > 0)
-		{
-			apu.channel4.volume_sweep_counter--;
+	// channel 4
+	if (apu.channel4.volume_envelope.bits.envelope_period > 0)
+	{
+		apu.channel4.volume_sweep_counter--;
 
-			if (apu.channel4.volume_sweep_counter == 0)
+		if (apu.channel4.volume_sweep_counter == 0)
+		{
+			if (apu.channel4.volume_envelope.bits.envelope_direction)  // increase volume
 			{
-				if (apu.channel4.volume_envelope.bits.envelope_direction)  // increase volume
-				{
-					if (apu.channel4.volume < 15)
-						apu.channel4.volume++;
-				}
-				else    // decrease volume
-					if (apu.channel4.volume > 0)
-						apu.channel4.volume--;
+				if (apu.channel4.volume < 15)
+					apu.channel4.volume++;
 			}
-			else if (apu.channel4.volume_sweep_counter == UINT8_MAX)
-				apu.channel4.volume_sweep_counter = apu.channel4.volume_envelope.bits.envelope_period;
+			else    // decrease volume
+				if (apu.channel4.volume > 0)
+					apu.channel4.volume--;
 		}
+		else if (apu.channel4.volume_sweep_counter == UINT8_MAX)
+			apu.channel4.volume_sweep_counter = apu.channel4.volume_envelope.bits.envelope_period;
 	}
+}
 
-	/**** channels' output ****/
+// frame sequencer @ 512 Hz, clocked by falling edge of DIV bit 12 (DIV-APU event)
+//   step:    0   1   2   3   4   5   6   7
+//   length:  x       x       x       x        @ 256 Hz
+//   sweep:           x               x        @ 128 Hz
+//   envelope:                            x    @ 64 Hz
+void APU_frame_sequencer_clock(void)
+{
+	if (!apu.sound_controller_on_off.bits.sound_controller_on)
+		return;
 
-	// channel 1
-	if (apu.sound_controller_on_off.bits.channel1_on)
-		apu.channel1.digital_output = (apu.channel1.waveform_generator & 0x01) * apu.channel1.volume;  // 0 -- 15
-	else
-		apu.channel1.digital_output = 0;
+	uint8_t step = apu.frame_sequencer_step;
+	apu.frame_sequencer_step = (step + 1) & 0x07;
 
-	if (apu.channel1.DAC_enabled)
-		apu.channel1.DAC = apu.channel1.digital_output * (2.0f / 15) - 1.0f;   // -1.0V -- 1.0V
-	else
-		apu.channel1.DAC = 0.0f;
+	if (step % 2 == 0)
+		APU_clock_length_counters();
 
-	// channel 2
-	if (apu.sound_controller_on_off.bits.channel2_on)
-		apu.channel2.digital_output = (apu.channel2.waveform_generator & 0x01) * apu.channel2.volume;  // 0 -- 15
-	else
-		apu.channel2.digital_output = 0;
+	if (step == 2 || step == 6)
+		APU_clock_sweep();
 
-	if (apu.channel2.DAC_enabled)
-		apu.channel2.DAC = apu.channel2.digital_output * (2.0f / 15) - 1.0f;   // -1.0V -- 1.0V
-	else
-		apu.channel2.DAC = 0.0f;
+	if (step == 7 && apu.synthesis)   // envelope volume is only heard, never read back
+		APU_clock_envelopes();
 
-	// channel 3
-	if (apu.sound_controller_on_off.bits.channel3_on)
-		if (apu.channel3.output_level_select.bits.output_level_select == 0)
-			apu.channel3.digital_output = 0;  // 0 -- 15
-		else
-			apu.channel3.digital_output = apu.channel3.sample_buffer / apu.channel3.output_level_select.bits.output_level_select;
-	else
-		apu.channel3.digital_output = 0;
+	APU_update_outputs();   // volume steps and channels switched off by their length counter or sweep
+}
 
-	if (apu.channel3.DAC_enabled)
-		apu.channel3.DAC = apu.channel3.digital_output * (2.0f / 15) - 1.0f;   // -1.0V -- 1.0V
-	else
-		apu.channel3.DAC = 0.0f;
+// channels' frequency timers count down clock cycles and are advanced in bulk - each step of a waveform is
+// timestamped at the cycle its timer reached zero, the outputs are not sampled or mixed in between
+void APU_clock(uint8_t cycles)
+{
+	// audio disabled: waveform generation, LFSR, DACs and mixing are skipped, length counters
+	// and sweep (NR52 channel on flags) keep running on the frame sequencer
+	if (!apu.synthesis)
+		return;
 
-	// channel 4
-	if (apu.sound_controller_on_off.bits.channel4_on)
-		apu.channel4.digital_output = (apu.channel4.linear_feedback_register & 0x0001 ? 0 : 1) * apu.channel4.volume;  // 0 -- 15
-	else
-		apu.channel4.digital_output = 0;
+	uint32_t end = apu.frame_cycles + cycles;   // a timer at -n reached zero n cycles before the end
 
-	if (apu.channel4.DAC_enabled)
-		apu.channel4.DAC = apu.channel4.digital_output * (2.0f / 15) - 1.0f;   // -1.0V -- 1.0V
-	else
-		apu.channel4.DAC = 0.0f;
+	// clock channel 1 frequency timer
+	apu.channel1.frequency_timer -= cycles;
 
-	// right and left output terminal
-	apu.SO1_output = 0.0f;
-	apu.SO2_output = 0.0f;
-	
-	// right speaker output
-	if (apu.sound_output_terminal_selection.bits.channel1_to_SO1)
-		apu.SO1_output += apu.channel1.DAC;
-	if (apu.sound_output_terminal_selection.bits.channel2_to_SO1)
-		apu.SO1_output += apu.channel2.DAC;
-	if (apu.sound_output_terminal_selection.bits.channel3_to_SO1)
-		apu.SO1_output += apu.channel3.DAC;
-	if (apu.sound_output_terminal_selection.bits.channel4_to_SO1)
-		apu.SO1_output += apu.channel4.DAC;
+	while (apu.channel1.frequency_timer <= 0)
+	{
+		uint8_t bit0 = apu.channel1.waveform_generator >> 7;
+		apu.channel1.waveform_generator <<= 1;
+		apu.channel1.waveform_generator |= bit0 & 0x01;
+
+		channel1_output(end + apu.channel1.frequency_timer);
+		apu.channel1.frequency_timer += channel1_period();
+	}
+
+	// clock channel 2 frequency timer
+	apu.channel2.frequency_timer -= cycles;
+
+	while (apu.channel2.frequency_timer <= 0)
+	{
+		uint8_t bit0 = apu.channel2.waveform_generator >> 7;
+		apu.channel2.waveform_generator <<= 1;
+		apu.channel2.waveform_generator |= bit0 & 0x01;
+
+		channel2_output(end + apu.channel2.frequency_timer);
+		apu.channel2.frequency_timer += channel2_period();
+	}
+
+	// clock channel 3 frequency timer
+	apu.channel3.frequency_timer -= cycles;
+
+	while (apu.channel3.frequency_timer <= 0)
+	{
+		apu.channel3.position_counter++; // sample num 0 - 31
+		apu.channel3.position_counter &= 0x1F;  // wrap around
+
+		uint8_t samples = apu.channel3.wave_RAM[apu.channel3.position_counter / 2];
+
+		if (apu.channel3.position_counter % 2)
+			apu.channel3.sample_buffer = samples & 0x0F;
+		else
+			apu.channel3.sample_buffer = samples >> 4 & 0x0F;
 
-	apu.SO1_output *= apu.channel_control_on_off_volume.bits.S01_output_level + 1;
+		channel3_output(end + apu.channel3.frequency_timer);
+		apu.channel3.frequency_timer += channel3_period();
+	}
+
+	// clock channel 4 frequency timer
+	apu.channel4.frequency_timer -= cycles;
+
+	while (apu.channel4.frequency_timer <= 0)
+	{
+		uint16_t result_bit = apu.channel4.linear_feedback_register & 0x0001 ^ apu.channel4.linear_feedback_register >> 1 & 0x0001;
+		apu.channel4.linear_feedback_register >>= 1;
+		apu.channel4.linear_feedback_register |= result_bit << 14;
 
-	// left speaker output
-	if (apu.sound_output_terminal_selection.bits.channel1_to_SO2)
-		apu.SO2_output += apu.channel1.DAC;
-	if (apu.sound_output_terminal_selection.bits.channel2_to_SO2)
-		apu.SO2_output += apu.channel2.DAC;
-	if (apu.sound_output_terminal_selection.bits.channel3_to_SO2)
-		apu.SO2_output += apu.channel3.DAC;
-	if (apu.sound_output_terminal_selection.bits.channel4_to_SO2)
-		apu.SO2_output += apu.channel4.DAC;
+		if (apu.channel4.polynomial_counter.bits.counter_step_width == 1)
+		{
+			apu.channel4.linear_feedback_register &= ~(1 << 6);
+			apu.channel4.linear_feedback_register |= result_bit << 6;
+		}
 
-	apu.SO2_output *= apu.channel_control_on_off_volume.bits.S02_output_level + 1;
+		channel4_output(end + apu.channel4.frequency_timer);
+		apu.channel4.frequency_timer += channel4_period();
+	}
 
-	apu.clock_cycles++;
+	apu.frame_cycles = end;
 }
 
 /**************************************** CHANNEL 1 ****************************************/
@@ -750,6 +906,8 @@ void APU_write_NR11(uint8_t value)
 			apu.channel1.waveform_generator = 0x7E;  // 0111.1110
 			break;
 	}
+
+	channel1_output(apu.frame_cycles);
 }
 
 void APU_write_NR12(uint8_t value)
@@ -766,24 +924,22 @@ void APU_write_NR12(uint8_t value)
 	}
 	else
 		apu.channel1.DAC_enabled = 1;
+
+	channel1_output(apu.frame_cycles);
 }
 
 void APU_write_NR13(uint8_t value)
 {
 	apu.channel1.frequency_low.reg = value;
 
-	uint16_t frequency_timer_reload_value = ~(apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg) + 1 & 0x07FF;
-	//uint16_t frequency_timer_reload_value = 2047 + 1 - (apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg);
-	apu.channel1.frequency_timer = frequency_timer_reload_value;
+	apu.channel1.frequency_timer = channel1_period();
 }
 
 void APU_write_NR14(uint8_t value)
 {
 	apu.channel1.frequency_high.reg = value;
 
-	uint16_t frequency_timer_reload_value = ~(apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg) + 1 & 0x07FF;
-	//uint16_t frequency_timer_reload_value = 2047 + 1 - (apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg);
-	apu.channel1.frequency_timer = frequency_timer_reload_value;
+	apu.channel1.frequency_timer = channel1_period();
 
 	if (apu.channel1.frequency_high.bits.initial == 1)
 	{
@@ -792,9 +948,7 @@ void APU_write_NR14(uint8_t value)
 			apu.channel1.length_counter = 63;
 
 		// init frequency timer
-		uint16_t frequency_timer_reload_value = ~(apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg) + 1 & 0x07FF;
-		//uint16_t frequency_timer_reload_value = 2047 + 1 - (apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg);
-		apu.channel1.frequency_timer = frequency_timer_reload_value;
+		apu.channel1.frequency_timer = channel1_period();
 
 		// init frequency sweep
 		apu.channel1.sweep_shadow_frequency_register = apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg;
@@ -823,8 +977,7 @@ void APU_write_NR14(uint8_t value)
 				apu.channel1.frequency_high.bits.frequency_high = new_frequency >> 8 & 0x07;
 				apu.channel1.frequency_low.reg = new_frequency & 0xFF;
 
-				uint16_t frequency_timer_reload_value = ~(apu.channel1.frequency_high.bits.frequency_high << 8 | apu.channel1.frequency_low.reg) + 1 & 0x07FF;
-				apu.channel1.frequency_timer = frequency_timer_reload_value;
+				apu.channel1.frequency_timer = channel1_period();
 			}
 		}
 
@@ -839,6 +992,8 @@ void APU_write_NR14(uint8_t value)
 		if (!apu.channel1.DAC_enabled)  
 			apu.sound_controller_on_off.bits.channel1_on = 0;
 	}
+
+	channel1_output(apu.frame_cycles);
 }
 
 /**************************************** CHANNEL 2 ****************************************/
@@ -884,6 +1039,8 @@ void APU_write_NR21(uint8_t value)
 			apu.channel2.waveform_generator = 0x7E;  // 0111.1110
 			break;
 	}
+
+	channel2_output(apu.frame_cycles);
 }
 
 void APU_write_NR22(uint8_t value)
@@ -900,33 +1057,29 @@ void APU_write_NR22(uint8_t value)
 	}
 	else
 		apu.channel2.DAC_enabled = 1;
+
+	channel2_output(apu.frame_cycles);
 }
 
 void APU_write_NR23(uint8_t value)
 {
 	apu.channel2.frequency_low.reg = value;
 
-	uint16_t frequency_timer_reload_value = ~(apu.channel2.frequency_high.bits.frequency_high << 8 | apu.channel2.frequency_low.reg) + 1 & 0x07FF;
-	//uint16_t frequency_timer_reload_value = 2047 + 1 - (apu.channel2.frequency_high.bits.frequency_high << 8 | apu.channel2.frequency_low.reg);
-	apu.channel2.frequency_timer = frequency_timer_reload_value;
+	apu.channel2.frequency_timer = channel2_period();
 }
 
 void APU_write_NR24(uint8_t value)
 {
 	apu.channel2.frequency_high.reg = value;
 
-	uint16_t frequency_timer_reload_value = ~(apu.channel2.frequency_high.bits.frequency_high << 8 | apu.channel2.frequency_low.reg) + 1 & 0x07FF;
-	//uint16_t frequency_timer_reload_value = 2047 + 1 - (apu.channel2.frequency_high.bits.frequency_high << 8 | apu.channel2.frequency_low.reg);
-	apu.channel2.frequency_timer = frequency_timer_reload_value;
+	apu.channel2.frequency_timer = channel2_period();
 
 	if (apu.channel2.frequency_high.bits.initial == 1)
 	{
 		if (apu.channel2.length_counter == 0)
 			apu.channel2.length_counter = 63;
 
-		uint16_t frequency_timer_reload_value = ~(apu.channel2.frequency_high.bits.frequency_high << 8 | apu.channel2.frequency_low.reg) + 1 & 0x07FF;
-		//uint16_t frequency_timer_reload_value = 2047 + 1 - (apu.channel2.frequency_high.bits.frequency_high << 8 | apu.channel2.frequency_low.reg);
-		apu.channel2.frequency_timer = frequency_timer_reload_value;
+		apu.channel2.frequency_timer = channel2_period();
 
 		apu.channel2.volume = apu.channel2.volume_envelope.bits.initial_volume;
 		apu.channel2.volume_sweep_counter = apu.channel2.volume_envelope.bits.envelope_period;
@@ -936,6 +1089,8 @@ void APU_write_NR24(uint8_t value)
 		if (!apu.channel2.DAC_enabled)
 			apu.sound_controller_on_off.bits.channel2_on = 0;
 	}
+
+	channel2_output(apu.frame_cycles);
 }
 
 /**************************************** CHANNEL 3 ****************************************/
@@ -975,6 +1130,8 @@ void APU_write_NR30(uint8_t value)
 	}
 	else
 		apu.channel3.DAC_enabled = 1;
+
+	channel3_output(apu.frame_cycles);
 }
 
 void APU_write_NR31(uint8_t value)
@@ -988,30 +1145,29 @@ void APU_write_NR31(uint8_t value)
 void APU_write_NR32(uint8_t value)
 {
 	apu.channel3.output_level_select.reg = value;
+
+	channel3_output(apu.frame_cycles);
 }
 
 void APU_write_NR33(uint8_t value)
 {
 	apu.channel3.frequency_low.reg = value;
 
-	uint16_t frequency_timer_reload_value = ~(apu.channel3.frequency_high.bits.frequency_high << 8 | apu.channel3.frequency_low.reg) + 1 & 0x07FF;
-	apu.channel3.frequency_timer = frequency_timer_reload_value;
+	apu.channel3.frequency_timer = channel3_period();
 }
 
 void APU_write_NR34(uint8_t value)
 {
 	apu.channel3.frequency_high.reg = value;
 
-	uint16_t frequency_timer_reload_value = ~(apu.channel3.frequency_high.bits.frequency_high << 8 | apu.channel3.frequency_low.reg) + 1 & 0x07FF;
-	apu.channel3.frequency_timer = frequency_timer_reload_value;
+	apu.channel3.frequency_timer = channel3_period();
 
 	if (apu.channel3.frequency_high.bits.initial == 1)
 	{
 		if (apu.channel3.length_counter == 0)
 			apu.channel3.length_counter = 255;
 
-		uint16_t frequency_timer_reload_value = ~(apu.channel3.frequency_high.bits.frequency_high << 8 | apu.channel3.frequency_low.reg) + 1 & 0x07FF;
-		apu.channel3.frequency_timer = frequency_timer_reload_value;
+		apu.channel3.frequency_timer = channel3_period();
 
 		apu.channel3.position_counter = 0;
 
@@ -1020,6 +1176,8 @@ void APU_write_NR34(uint8_t value)
 		if (!apu.channel3.DAC_enabled)
 			apu.sound_controller_on_off.bits.channel3_on = 0;
 	}
+
+	channel3_output(apu.frame_cycles);
 }
 
 uint8_t APU_read_wave_table(uint16_t address)
@@ -1079,6 +1237,8 @@ void APU_write_NR42(uint8_t value)
 	}
 	else
 		apu.channel4.DAC_enabled = 1;
+
+	channel4_output(apu.frame_cycles);
 }
 
 void APU_write_NR43(uint8_t value)
@@ -1096,7 +1256,7 @@ void APU_write_NR44(uint8_t value)
 			apu.channel4.length_counter = 63;
 
 		apu.channel4.linear_feedback_register = 0x7FFF;
-		apu.channel4.frequency_timer = apu.channel4.polynomial_counter.bits.frequency_divide_ratio + 1 << apu.channel4.polynomial_counter.bits.shift_clock_frequency + 1;
+		apu.channel4.frequency_timer = channel4_period();
 
 		apu.channel4.volume = apu.channel4.volume_envelope.bits.initial_volume;
 		apu.channel4.volume_sweep_counter = apu.channel4.volume_envelope.bits.envelope_period;
@@ -1106,6 +1266,8 @@ void APU_write_NR44(uint8_t value)
 		if (!apu.channel4.DAC_enabled)
 			apu.sound_controller_on_off.bits.channel4_on = 0;
 	}
+
+	channel4_output(apu.frame_cycles);
 }
 
 /**************************************** APU control registers ****************************************/
@@ -1127,11 +1289,15 @@ uint8_t APU_read_NR52(void)
 void APU_write_NR50(uint8_t value)
 {
 	apu.channel_control_on_off_volume.reg = value;
+
+	APU_mix();
 }
 
 void APU_write_NR51(uint8_t value)
 {
 	apu.sound_output_terminal_selection.reg = value;
+
+	APU_mix();
 }
 
 void APU_write_NR52(uint8_t value)
@@ -1168,7 +1334,7 @@ void APU_write_NR52(uint8_t value)
 	}
 	else     // enable sound controller
 	{
-		apu.clock_cycles = 0;
+		apu.frame_sequencer_step = 0;
 
 		switch (apu.channel1.sound_length_and_duty_cycle.bits.duty_cycle)
 		{
@@ -1202,4 +1368,7 @@ void APU_write_NR52(uint8_t value)
 				break;
 		}
 	}
-}
+
+	APU_update_outputs();
+	APU_mix();
+}
\ No newline at end of file
@@ -2,11 +2,18 @@
 #define __APU_H__
 
 #include <stdint.h>
+#include "state.h"
 
-void APU_init(void);
+#define SAMPLING_FREQUENCY                                     44100   // default output sampling frequency
+
+void APU_init(uint32_t sampling_frequency);   // 0: audio disabled, register behaviour is unchanged
 void APU_deinit(void);
 
-void APU_clock(void);
+void APU_clock(uint8_t cycles);
+void APU_frame_sequencer_clock(void);
+void APU_end_frame(void);
+void APU_set_sampling_frequency(double frequency);   // output rate, adjusted by front ends for dynamic rate control
+void APU_state(State *state);
 
 uint8_t APU_read_NR10(void);
 uint8_t APU_read_NR11(void);
@@ -2,13 +2,22 @@
 #include "CPU.h"
 #include "instruction_set.h"
 #include "bus.h"
+#include "frontend.h"
 
 #include <stdint.h>
 
 CPU cpu;
 
-int CPU_init(void)
+int CPU_init(int boot_ROM)
 {
+    cpu.boot = boot_ROM;
+
+    if (!boot_ROM)
+    {
+        CPU_Reset();
+        return 1;
+    }
+
     // load bootstrap ROM 
     FILE *bootROM = fopen("ROMs/Nintendo Game Boy Boot ROM.gb", "rb");
     if (!bootROM)
@@ -18,6 +27,7 @@ int CPU_init(void)
     }
 
     size_t elements_read = fread(cpu.bootROM, 1, 0x100, bootROM);
+    fclose(bootROM);
     if (elements_read < 0x100)
     {
         printf("error reading boot ROM");
@@ -31,11 +41,7 @@ int CPU_init(void)
 
 void CPU_Reset(void)
 {
-    cpu.PC = 0x0000;
-    cpu.boot = 1;  // enable bootstrap ROM
-    
-    //cpu.boot = 0;    // disable bootstrap ROM
-    //cpu.PC = 0x0100;
+    cpu.PC = cpu.boot ? 0x0000 : 0x0100;   // bootstrap ROM enabled or post-boot state
 
     cpu.A = 0x01;
     cpu.F.reg = 0xB0;
@@ -67,6 +73,39 @@ void CPU_Reset(void)
     //CPU_log(cpu);
 }
 
+#define INSTRUCTION_EXTENDED      0x100   // snapshot index of the instruction being executed: opcode, 0x100 + extended opcode
+#define INSTRUCTION_INTERRUPT     0x200
+#define INSTRUCTION_HALT_EXIT     0x201
+
+void CPU_state(State *state)
+{
+    uint16_t instruction;
+
+    if (cpu.current_instruction == &interrupt)
+        instruction = INSTRUCTION_INTERRUPT;
+    else if (cpu.current_instruction == &halt_exit)
+        instruction = INSTRUCTION_HALT_EXIT;
+    else if (cpu.current_instruction >= extended_instruction_table && cpu.current_instruction < extended_instruction_table + 0x100)
+        instruction = INSTRUCTION_EXTENDED + (cpu.current_instruction - extended_instruction_table);
+    else
+        instruction = cpu.current_instruction - instruction_table;
+
+    state_io(state, &cpu, sizeof cpu);
+    state_io(state, &instruction, sizeof instruction);
+
+    if (!state->loading)
+        return;
+
+    if (instruction == INSTRUCTION_INTERRUPT)
+        cpu.current_instruction = &interrupt;
+    else if (instruction == INSTRUCTION_HALT_EXIT)
+        cpu.current_instruction = &halt_exit;
+    else if (instruction >= INSTRUCTION_EXTENDED)
+        cpu.current_instruction = &extended_instruction_table[instruction & 0xFF];
+    else
+        cpu.current_instruction = &instruction_table[instruction];
+}
+
 #define INT_VECTOR_VBLANK    0x0040
 #define INT_VECTOR_LCD       0x0048
 #define INT_VECTOR_TIMER     0x0050
@@ -190,7 +229,12 @@ void CPU_execute_machine_cycle(void)
                 cpu.current_instruction = &extended_instruction_table[cpu.instruction_register];  // "decode" extended instruction    
             }
             else
+            {
                 cpu.current_instruction = &instruction_table[cpu.instruction_register];           // "decode" instruction   
+
+                if (cpu.instruction_register == 0x40 && frontend.breakpoint)   // LD B,B
+                    frontend.breakpoint();
+            }
         }
 
         static int log = 0;
@@ -222,10 +266,10 @@ void CPU_log(void)
 
         uint8_t immediate8 = bus_read(cpu.PC);
         char intstr[3]; // 2 chars + null char
-        _itoa(immediate8, intstr, 16);
+        snprintf(intstr, sizeof intstr, "%X", immediate8);
 
         strcat(string, "0x");
-        strcat(string, _strupr(intstr));
+        strcat(string, intstr);
 
         strcat(string, p + 2);  // skip "u8"
        
@@ -240,10 +284,10 @@ void CPU_log(void)
         uint16_t immediate16 = bus_read(cpu.PC);
         immediate16 |= bus_read(cpu.PC + 1) << 8;
         char intstr[5]; // 4 chars + null char
-        _itoa(immediate16, intstr, 16);
+        snprintf(intstr, sizeof intstr, "%X", immediate16);
 
         strcat(string, "0x");                     
-        strcat(string, _strupr(intstr));
+        strcat(string, intstr);
 
         strcat(string, p + 3);  // skip "u16"
 
@@ -257,13 +301,13 @@ void CPU_log(void)
 
         int8_t signed_immediate8 = bus_read(cpu.PC);
         char intstr[5]; // 4 chars + null char - 3 chars + sign + null char
-        _itoa(cpu.PC - 1 + signed_immediate8 + 2, intstr, 16);
+        snprintf(intstr, sizeof intstr, "%X", (uint16_t)(cpu.PC - 1 + signed_immediate8 + 2));
         strcat(string, "0x");
-        strcat(string, _strupr(intstr));
+        strcat(string, intstr);
         strcat(string, " (");
         if (signed_immediate8 >= 0)
             strcat(string, "+");
-        _itoa(signed_immediate8 + 2, intstr, 10);
+        snprintf(intstr, sizeof intstr, "%d", signed_immediate8 + 2);
         strcat(string, intstr);
         strcat(string, ")");
 
@@ -2,6 +2,7 @@
 #define __CPU_H__
 
 #include <stdint.h>
+#include "state.h"
 
 typedef struct CPU CPU;
 
@@ -73,8 +74,9 @@ struct CPU
 
 extern CPU cpu;
 
-int CPU_init(void);
+int CPU_init(int boot_ROM);   // boot_ROM: load and run the bootstrap ROM, otherwise start at 0x0100 in the post-boot state
 void CPU_Reset(void);
+void CPU_state(State *state);
 void CPU_execute_machine_cycle(void);
 int CPU_check_interrupts(void);  
 void CPU_log(void);
@@ -1,14 +1,61 @@
 #include "DMA.h"
 #include "bus.h"
+#include "PPU.h"
+#include "gameboy.h"
+
+#define DMA_LENGTH                      160   // bytes - one per machine cycle
+#define DMA_CYCLES       (DMA_LENGTH * 4)    // clock cycles
 
 static uint16_t DMA_source_address;
 
 static uint8_t transferred;
 int DMA_active;
 
+static DMA_Mode DMA_mode = DMA_MODE_EXACT;   // fast mode is opt-in: --dma=fast
+static uint64_t DMA_end;   // clock cycle fast DMA ends
+int DMA_bus_locked;
+
+void DMA_state(State *state)
+{
+	state_io(state, &DMA_source_address, sizeof DMA_source_address);
+	state_io(state, &transferred, sizeof transferred);
+	state_io(state, &DMA_active, sizeof DMA_active);
+	state_io(state, &DMA_end, sizeof DMA_end);
+	state_io(state, &DMA_bus_locked, sizeof DMA_bus_locked);
+}
+
+void DMA_set_mode(DMA_Mode mode)
+{
+	DMA_mode = mode;
+}
+
 void DMA_start(uint8_t page)
 {
 	DMA_source_address = (uint16_t)page << 8 + 0x00;
+
+	if (DMA_mode == DMA_MODE_FAST)   // copy the whole table at once and lock the bus for the transfer time
+	{
+		const uint8_t *source = bus_page(page);
+		uint8_t data[DMA_LENGTH];
+
+		if (!source)   // not plain memory (cartridge, VRAM...) - go through the bus
+		{
+			DMA_bus_locked = 0;
+
+			for (int i = 0; i < DMA_LENGTH; i++)
+				data[i] = bus_read(DMA_source_address + i);
+
+			source = data;
+		}
+
+		write_OAM_block(source);
+
+		DMA_end = clock_cycles + DMA_CYCLES;
+		DMA_bus_locked = 1;
+
+		return;
+	}
+
 	transferred = 0;
 	DMA_active = 1;
 }
@@ -20,6 +67,15 @@ void DMA_copy(void)
 	
 	transferred++;
 
-	if (transferred == 160)
+	if (transferred == DMA_LENGTH)
 		DMA_active = 0;
+}
+
+// end of fast DMA is not clocked, it is checked when the CPU accesses the bus
+int DMA_check_bus_lock(void)
+{
+	if (clock_cycles >= DMA_end)
+		DMA_bus_locked = 0;
+
+	return DMA_bus_locked;
 }
\ No newline at end of file
@@ -2,10 +2,21 @@
 #define __DMA_H__
 
 #include <stdint.h>
+#include "state.h"
+
+typedef enum DMA_Mode
+{
+	DMA_MODE_FAST,       // OAM copied at once when DMA starts, CPU restricted to HRAM and IO registers for the transfer time
+	DMA_MODE_EXACT       // one byte copied per machine cycle
+} DMA_Mode;
 
 extern int DMA_active;
+extern int DMA_bus_locked;   // fast DMA transfer may still be in progress
 
+void DMA_set_mode(DMA_Mode mode);
 void DMA_start(uint8_t page);
 void DMA_copy(void);
+int DMA_check_bus_lock(void);
+void DMA_state(State *state);   // DMA mode is a setting of the instance, not state
 
 #endif 
\ No newline at end of file
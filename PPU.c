@@ -1,7 +1,8 @@
 #include "PPU.h"
 #include "bus.h"
-#include "SDL2/SDL.h"
+#include "frontend.h"
 #include <stdint.h>
+#include <string.h>
 
 /**** PPU registers ****/
 #define LCDC_POWER_BIT                   0x80
@@ -13,10 +14,6 @@
 #define STAT_MODE2_INTERRUPT_OAM_BIT     0x20
 #define STAT_LYC_INTERRUPT_BIT           0x40
 
-/**** display resolution ****/
-#define DISPLAY_WIDTH                     160
-#define DISPLAY_HEIGHT                    144
-
 /**** VRAM ****/
 #define VRAM_ADDRESS_BASE               0x8000
 #define SPRITE_TILE_DATA_ADDRESS_BASE   0x8000
@@ -181,6 +178,9 @@ static PPU ppu;
 static uint8_t VRAM[0x2000];      // 8 KB VRAM
 static uint8_t OAM[0x80 + 0x20];  // 40 x 4 = 160 bytes
 
+static uint8_t spriteX;           // OAM search: sprite attributes read on the previous cycle
+static uint8_t spriteY;
+
 void write_VRAM(uint16_t address, uint8_t data)
 {
 	address &= 0x1FFF;
@@ -207,6 +207,11 @@ void write_OAM(uint16_t address, uint8_t data)
 		OAM[address] = data;
 }
 
+void write_OAM_block(const uint8_t *data)
+{
+	memcpy(OAM, data, 160);
+}
+
 uint8_t read_OAM(uint16_t address)
 {
 	address &= 0x00FF;
@@ -217,73 +222,20 @@ uint8_t read_OAM(uint16_t address)
 	//	return 0xFF;
 }
 
-static SDL_Window *window;
-static SDL_Renderer *renderer;
-
-static SDL_Texture *background_map;
-static uint8_t background_buffer[256 * 256 * 4];
-
-static SDL_Texture *window_map;
-static uint8_t window_buffer[256 * 256 * 4];
-
-static SDL_Texture *tile_data;
-static uint8_t tile_buffer[16 * 24 * 64 * 4]; // 16 x 24 tiles, each 64 pixels, each pixel 4 bytes
-
-static SDL_Texture *display;
 static uint8_t buffer[DISPLAY_WIDTH * DISPLAY_HEIGHT * 4];
 
-void PPU_init(void)
+void PPU_state(State *state)
 {
-	// initialize graphics system
-	if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0)
-	{
-		printf("error initializing SDL: %s", SDL_GetError());
-		return -1;
-	}
-
-	uint8_t paddingX = 60, paddingY = 20;
-	window = SDL_CreateWindow("GameBoy Emulator", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, paddingX + DISPLAY_WIDTH * 4 + 8 * 8 + 256 * 2, paddingY + DISPLAY_HEIGHT * 4, 0);
-	if (!window)
-	{
-		printf("error creating window: %s", SDL_GetError());
-		return -1;
-	}
-
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-	if (!renderer)
-	{
-		printf("error creating renderer: %s", SDL_GetError());
-		return -1;
-	}
-
-	display = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_WIDTH, DISPLAY_HEIGHT);
-	if (!display)
-	{
-		printf("error creating texture: %s", SDL_GetError());
-		return -1;
-	}
-
-	background_map = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, 256, 256);
-	if (!display)
-	{
-		printf("error creating texture: %s", SDL_GetError());
-		return -1;
-	}
-
-	window_map = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, 256, 256);
-	if (!display)
-	{
-		printf("error creating texture: %s", SDL_GetError());
-		return -1;
-	}
-
-	tile_data = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, 16 * 8, 24 * 8);
-	if (!display)
-	{
-		printf("error creating texture: %s", SDL_GetError());
-		return -1;
-	}
+	state_io(state, &ppu, sizeof ppu);
+	state_io(state, VRAM, sizeof VRAM);
+	state_io(state, OAM, sizeof OAM);
+	state_io(state, &spriteX, sizeof spriteX);
+	state_io(state, &spriteY, sizeof spriteY);
+	state_io(state, buffer, sizeof buffer);   // frame being drawn
+}
 
+void PPU_init(void)
+{
 	// initialize PPU
 	ppu.state = PPU_STATE_VBLANK;
 	ppu.LY = DISPLAY_HEIGHT;
@@ -296,18 +248,13 @@ void PPU_init(void)
 
 void PPU_deinit(void)
 {
-	SDL_DestroyTexture(display);
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
+
 }
 
 #include <limits.h>
 
 void PPU_clock(void)  
 {
-	static uint8_t spriteX;
-	static uint8_t spriteY;
-
 	switch (ppu.state)
 	{
 		case PPU_STATE_OAM_SEARCH:  //////////////////////////////////////////////// MODE 2: OAM memory search (80 clock cycles)
@@ -915,11 +862,9 @@ void PPU_clock(void)
 				if (ppu.STAT.bits.mode1_VBLANK_interrupt)
 					set_int_flag(INT_LCD_STAT);  	
 
-				// render frame
-				PPU_render_VRAM();
-
-				if (ppu.LCDC.bits.LCD_power)
-					PPU_render();
+				// hand completed frame to the front end
+				if (ppu.LCDC.bits.LCD_power && frontend.video_frame)
+					frontend.video_frame((const uint32_t*)buffer);
 
 				// reset window internal line counter
 				ppu.window_line_count = 0;
@@ -953,7 +898,8 @@ void PPU_clock(void)
 	}
 }
 
-void PPU_render_VRAM(void)
+// debug view of VRAM: tile data (16 x 24 tiles), background and window tile maps (256 x 256 pixels), 0x00RRGGBB pixels
+void PPU_render_VRAM(uint8_t *tile_buffer, uint8_t *background_buffer, uint8_t *window_buffer)
 {
 	// render tiles
 	for (int i = 0; i < 24; i++)
@@ -1053,30 +999,6 @@ void PPU_render_VRAM(void)
 		}
 }
 
-void PPU_render(void)
-{
-	SDL_SetRenderDrawColor(renderer, 0xD0, 0xD0, 0xD0, 0x00);
-	SDL_RenderClear(renderer);
-
-	SDL_UpdateTexture(display, NULL, (const void*)buffer, DISPLAY_WIDTH * 4);
-	SDL_Rect display_rect = { 10, 10, DISPLAY_WIDTH * 4, DISPLAY_HEIGHT * 4 };
-	SDL_RenderCopy(renderer, display, NULL, &display_rect);
-
-	SDL_UpdateTexture(background_map, NULL, (const void*)background_buffer, 256 * 4);
-	SDL_Rect background_map_rect = { 10 + DISPLAY_WIDTH * 4 + 10, 10, 256 * 1, 256 * 1};
-	SDL_RenderCopy(renderer, background_map, NULL, &background_map_rect);
-
-	SDL_UpdateTexture(window_map, NULL, (const void*)window_buffer, 256 * 4);
-	SDL_Rect window_map_rect = { 10 + DISPLAY_WIDTH * 4 + 10, 10 + 256 * 1.1 + 10, 256 * 1 , 256 * 1};
-	SDL_RenderCopy(renderer, window_map, NULL, &window_map_rect);
-
-	SDL_UpdateTexture(tile_data, NULL, (const void*)tile_buffer, 16 * 8 * 4);
-	SDL_Rect tile_data_rect = { 20 + DISPLAY_WIDTH * 4 + 10 + 256 * 1.1, 10 , 16 * 8 *2, 24 * 8 *2};
-	SDL_RenderCopy(renderer,tile_data, NULL, &tile_data_rect);
-
-	SDL_RenderPresent(renderer);
-}
-
 void PPU_write_LCDC(uint8_t value)
 {
 	if (!(value & LCDC_POWER_BIT))
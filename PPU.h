@@ -1,15 +1,20 @@
 #ifndef __PPU_H__
-#define __PPU_H_
+#define __PPU_H__
 
 #include <stdint.h>
+#include "state.h"
+
+/**** display resolution ****/
+#define DISPLAY_WIDTH                     160
+#define DISPLAY_HEIGHT                    144
 
 void PPU_init(void);
 void PPU_deinit(void);
 
 void PPU_clock(void);
+void PPU_state(State *state);
 
-void PPU_render(void);
-void PPU_render_VRAM(void);
+void PPU_render_VRAM(uint8_t *tile_buffer, uint8_t *background_buffer, uint8_t *window_buffer);
 
 void PPU_write_LCDC(uint8_t value);
 void PPU_write_STAT(uint8_t value);
@@ -36,5 +41,6 @@ uint8_t read_VRAM(uint16_t address);
 
 void write_OAM(uint16_t address, uint8_t data);
 uint8_t read_OAM(uint16_t address);
+void write_OAM_block(const uint8_t *data);   // whole 160 bytes table (OAM DMA)
 
-#endif  // __PPU_H_
\ No newline at end of file
+#endif  // __PPU_H__
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "blip.h"
+#include <string.h>
+#include <math.h>
+
+#define KERNEL_UNIT_BITS                15       // kernel coefficients of each phase sum to 1 << 15
+#define CUTOFF                        0.90       // low-pass cutoff relative to Nyquist frequency
+
+static int16_t kernel[BLIP_PHASES][BLIP_TAPS];   // band-limited impulse (Blackman windowed sinc) for each sub-sample phase
+static int kernel_ready;
+
+static void kernel_init(void)
+{
+	const double pi = 3.14159265358979323846;
+
+	for (int phase = 0; phase < BLIP_PHASES; phase++)
+	{
+		double taps[BLIP_TAPS];
+		double sum = 0.0;
+
+		for (int i = 0; i < BLIP_TAPS; i++)
+		{
+			double x = i - (BLIP_TAPS / 2 - 1) - (double)phase / BLIP_PHASES;   // distance from step position in samples
+			double sinc = x == 0.0 ? CUTOFF : sin(pi * CUTOFF * x) / (pi * x);
+			double window = 0.42 + 0.5 * cos(pi * x / (BLIP_TAPS / 2)) + 0.08 * cos(2.0 * pi * x / (BLIP_TAPS / 2));
+
+			taps[i] = sinc * window;
+			sum += taps[i];
+		}
+
+		// normalize so that each step settles exactly to its delta (no drift in the integrator)
+		int total = 0;
+		for (int i = 0; i < BLIP_TAPS; i++)
+		{
+			kernel[phase][i] = (int16_t)floor(taps[i] / sum * (1 << KERNEL_UNIT_BITS) + 0.5);
+			total += kernel[phase][i];
+		}
+
+		kernel[phase][BLIP_TAPS / 2 - 1] += (1 << KERNEL_UNIT_BITS) - total;
+	}
+
+	kernel_ready = 1;
+}
+
+void blip_init(Blip *blip, uint32_t clock_rate, uint32_t sample_rate)
+{
+	if (!kernel_ready)
+		kernel_init();
+
+	blip_set_rates(blip, clock_rate, sample_rate);
+	blip_clear(blip);
+}
+
+// can be changed between frames to resample slightly faster or slower
+void blip_set_rates(Blip *blip, double clock_rate, double sample_rate)
+{
+	blip->factor = (uint64_t)(sample_rate / clock_rate * 4294967296.0);
+}
+
+void blip_clear(Blip *blip)
+{
+	blip->offset = 0;
+	blip->integrator = 0;
+
+	memset(blip->buffer, 0, sizeof blip->buffer);
+}
+
+void blip_add_delta(Blip *blip, uint32_t time, int delta)
+{
+	uint64_t position = blip->offset + time * blip->factor;
+	uint32_t index = (uint32_t)(position >> 32);
+	const int16_t *step = kernel[(uint32_t)position >> (32 - BLIP_PHASE_BITS)];
+
+	if (index > BLIP_BUFFER_SIZE)   // buffer full, samples are not being read
+		return;
+
+	int32_t *out = blip->buffer + index;
+
+	for (int i = 0; i < BLIP_TAPS; i++)
+		out[i] += step[i] * delta;
+}
+
+void blip_end_frame(Blip *blip, uint32_t time)
+{
+	blip->offset += time * blip->factor;
+
+	if (blip->offset >> 32 > BLIP_BUFFER_SIZE)
+		blip->offset = (uint64_t)BLIP_BUFFER_SIZE << 32;
+}
+
+int blip_samples_avail(const Blip *blip)
+{
+	return (int)(blip->offset >> 32);
+}
+
+int blip_read_samples(Blip *blip, int16_t *out, int count, int stride)
+{
+	int avail = blip_samples_avail(blip);
+
+	if (count > avail)
+		count = avail;
+
+	int32_t sum = blip->integrator;
+
+	for (int i = 0; i < count; i++)
+	{
+		sum += blip->buffer[i];
+
+		int32_t sample = sum >> KERNEL_UNIT_BITS;
+
+		if (sample > INT16_MAX)
+			sample = INT16_MAX;
+		else if (sample < INT16_MIN)
+			sample = INT16_MIN;
+
+		out[i * stride] = (int16_t)sample;
+	}
+
+	blip->integrator = sum;
+
+	// remove read samples, keeping the kernel tails that spill past the last available sample
+	int remaining = avail - count + BLIP_TAPS;
+	memmove(blip->buffer, blip->buffer + count, remaining * sizeof blip->buffer[0]);
+	memset(blip->buffer + remaining, 0, count * sizeof blip->buffer[0]);
+
+	blip->offset -= (uint64_t)count << 32;
+
+	return count;
+}
\ No newline at end of file
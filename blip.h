@@ -0,0 +1,34 @@
+#ifndef __BLIP_H__
+#define __BLIP_H__
+
+#include <stdint.h>
+
+// band-limited step synthesis: amplitude changes are added as deltas at clock timestamps and
+// turned into band-limited steps at the output sample rate, samples are read in batches
+
+#define BLIP_PHASE_BITS                  5
+#define BLIP_PHASES     (1 << BLIP_PHASE_BITS)   // sub-sample step positions
+#define BLIP_TAPS                       16       // kernel width in output samples
+#define BLIP_BUFFER_SIZE              4096       // max samples buffered between reads
+
+typedef struct Blip Blip;
+
+struct Blip
+{
+	uint64_t factor;       // output samples per clock (32.32 fixed point)
+	uint64_t offset;       // end of last frame in output samples from buffer start (32.32 fixed point)
+	int32_t integrator;    // running sum of deltas
+	int32_t buffer[BLIP_BUFFER_SIZE + BLIP_TAPS];
+};
+
+void blip_init(Blip *blip, uint32_t clock_rate, uint32_t sample_rate);
+void blip_set_rates(Blip *blip, double clock_rate, double sample_rate);
+void blip_clear(Blip *blip);
+
+void blip_add_delta(Blip *blip, uint32_t time, int delta);
+void blip_end_frame(Blip *blip, uint32_t time);
+
+int blip_samples_avail(const Blip *blip);
+int blip_read_samples(Blip *blip, int16_t *out, int count, int stride);
+
+#endif  // __BLIP_H__
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stddef.h>
 #include "bus.h"
 #include "CPU.h"
 #include "PPU.h"
@@ -19,9 +20,20 @@ void bus_reset(void)
 
 }
 
+void bus_state(State *state)
+{
+    state_io(state, WRAM, sizeof WRAM);
+    state_io(state, HRAM, sizeof HRAM);
+    state_io(state, &IE, sizeof IE);
+    state_io(state, &IF, sizeof IF);
+}
+
 /**** bus interface ****/
 uint8_t bus_read(uint16_t address)
 {
+    if (DMA_bus_locked && address < 0xFF00 && DMA_check_bus_lock())   // fast OAM DMA in progress: only HRAM and IO registers are accessible
+        return 0xFF;
+
     if (address >= 0x0000 && address <= 0x7FFF)             ////////////// cartridge ROM - 32 KB
         if (address <= 0x00FF && cpu.boot)
             return cpu.bootROM[address & 0xFF];             ////////////// bootstrap ROM mapped to 0x00 - 0xFF - 256 Bytes
@@ -30,7 +42,7 @@ uint8_t bus_read(uint16_t address)
     else if (address >= 0x8000 && address <= 0x9FFF)        ////////////// VRAM - 8KB
         return read_VRAM(address);
     else if (address >= 0xA000 && address <= 0xBFFF)        ////////////// external RAM - 8 KB
-        ;
+        return cartridge_read_RAM(address);
     else if (address >= 0xC000 && address <= 0xDFFF)        ////////////// work RAM - 8KB
         return WRAM[address & 0x1FFF];
     else if (address >= 0xE000 && address <= 0xFFFF)
@@ -142,14 +154,25 @@ uint8_t bus_read(uint16_t address)
         }
 }
 
+const uint8_t *bus_page(uint8_t page)
+{
+    if (page >= 0xC0 && page <= 0xDF)                       ////////////// work RAM - 8KB
+        return WRAM + (page << 8 & 0x1FFF);
+    else
+        return NULL;
+}
+
 void bus_write(uint16_t address, uint8_t data)
 {
+    if (DMA_bus_locked && address < 0xFF00 && DMA_check_bus_lock())
+        return;
+
     if (address >= 0x0000 && address <= 0x7FFF)             ////////////// cartridge ROM - 32KB
         cartridge_write(address, data);
     else if (address >= 0x8000 && address <= 0x9FFF)        ////////////// VRAM - 8KB
         write_VRAM(address, data);
     else if (address >= 0xA000 && address <= 0xBFFF)        ////////////// external RAM - 8KB
-        cartridge_write(address, data);
+        cartridge_write_RAM(address, data);
     else if (address >= 0xC000 && address <= 0xDFFF)        ////////////// work RAM - 8KB
         WRAM[address & 0x1FFF] = data;
     else if (address >= 0xE000 && address <= 0xFFFF)
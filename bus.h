@@ -2,6 +2,7 @@
 #define __BUS_H__
 
 #include <stdint.h>
+#include "state.h"
 
 #define INT_ENABLE_REG     0xFFFF
 #define INT_FLAG_REG       0xFF0F
@@ -22,6 +23,8 @@
 
 uint8_t bus_read(uint16_t address);
 void bus_write(uint16_t address, uint8_t data);
+const uint8_t *bus_page(uint8_t page);   // memory backing a 256 byte page, NULL if it is not plain memory
+void bus_state(State *state);
 
 enum Int_Flag { INT_VBLANK = 0x01, INT_LCD_STAT = 0x02, INT_TIMER = 0x04, INT_SERIAL = 0x08, INT_JOYPAD = 0x10 };
 
@@ -1,182 +1,921 @@
 #include "cartridge.h"
+#include "gameboy.h"
+#include "patch.h"
+#include "rom_index.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
 
-enum MBC
+#define ROM_BANK_SIZE     0x4000
+#define RAM_BANK_SIZE     0x2000
+#define MBC2_RAM_SIZE     0x200     // 512 x 4 bits built into the MBC2 chip
+
+#define SAVE_PAGE_SIZE    0x1000    // dirty tracking granularity of battery backed RAM
+#define SAVE_FLUSH_CYCLES CLOCK_FREQUENCY   // battery backed RAM is written back once per emulated second
+#define RTC_FOOTER_SIZE   48        // MBC3 clock appended to the .sav file
+
+/**** mappers ****/
+// bank select writes recompute the ROM and RAM window pointers, reads are a pointer plus offset
+typedef struct Mapper
 {
-    ROM_ONLY = 0, MBC1, MBC1_RAM, MBC1_RAM_BATTERY, MBC2 = 5, MBC2_BATTERY,
-};
+    const char *name;
+    void (*reset)(void);
+    void (*map)(void);                               // recompute the windows from the MBC registers
+    void (*write)(uint16_t address, uint8_t data);   // MBC register write 0x0000 - 0x7FFF (optional)
+    uint8_t (*read_RAM)(uint16_t address);           // 0xA000 - 0xBFFF when no RAM bank is mapped (optional)
+    void (*write_RAM)(uint16_t address, uint8_t data);
+} Mapper;
 
 typedef struct Cartridge
 {
-    uint8_t *ROM;  // 32 KB cartridge ROM address space 0x0000 - 0x7FFF
+    uint8_t *ROM;  // whole ROM file mapped read-only, banks switched into 0x4000 - 0x7FFF
+    size_t ROM_length;
+    size_t ROM_map_length;   // ROM mapping, may be longer than a patched ROM
+    uint32_t ROM_banks;
     uint8_t *RAM;  
+    uint32_t RAM_banks;
+    size_t RAM_length;
+    int battery;   // RAM is backed by a memory mapped .sav file
+    int RTC_footer;        // the .sav file also holds the MBC3 clock, after the RAM
+    size_t save_length;    // .sav file mapping: RAM + clock footer
     char title[0x10];
-    enum MBC MBC;
+    uint8_t type;
+    const Mapper *mapper;
     uint8_t ROM_size;
     uint8_t RAM_size;
 } Cartridge;
 
 static Cartridge *cartridge = NULL;
 
-int cartridge_load(const char *rom_name)
+uint64_t cartridge_next_flush = UINT64_MAX;
+static uint32_t dirty_pages;           // one bit per SAVE_PAGE_SIZE page of battery backed RAM written since the last flush
+
+static const uint8_t *ROM_window[2];   // 0x0000 - 0x3FFF and 0x4000 - 0x7FFF
+static uint8_t *RAM_window;            // 0xA000 - 0xBFFF (NULL: RAM disabled, absent or handled by the mapper)
+static uint16_t RAM_mask;              // 2 KB RAM is mirrored through the 8 KB window
+
+// MBC registers
+static int RAM_enabled;
+static uint16_t ROM_bank;
+static uint8_t RAM_bank;
+static uint8_t banking_mode;           // MBC1
+
+static void map_ROM(uint32_t bank0, uint32_t bank1)
 {
-    cartridge = (Cartridge*)malloc(sizeof(Cartridge));
-    
-    char rom_path[100] = "ROMs/";
-    strcat(rom_path, rom_name);
-    strcat(rom_path, ".gb");
+    ROM_window[0] = cartridge->ROM + (bank0 % cartridge->ROM_banks) * ROM_BANK_SIZE;
+    ROM_window[1] = cartridge->ROM + (bank1 % cartridge->ROM_banks) * ROM_BANK_SIZE;
+}
+
+static void map_RAM(uint32_t bank)
+{
+    if (RAM_enabled && cartridge->RAM_banks)
+        RAM_window = cartridge->RAM + (bank % cartridge->RAM_banks) * RAM_BANK_SIZE;
+    else
+        RAM_window = NULL;
+}
+
+static void enable_RAM(uint8_t data)
+{
+    int enabled = (data & 0x0F) == 0x0A;
+
+    if (RAM_enabled && !enabled && dirty_pages)   // games disable RAM when they are done saving
+        cartridge_flush(0);
+
+    RAM_enabled = enabled;
+}
+
+/**** ROM only ****/
+static void ROM_only_map(void)
+{
+    map_ROM(0, 1);
+    map_RAM(0);
+}
+
+static void ROM_only_reset(void)
+{
+    RAM_enabled = 1;   // ROM + RAM cartridges have RAM permanently enabled
+    ROM_only_map();
+}
+
+/**** MBC1 - max 2 MB ROM + 32 KB RAM ****/
+static void MBC1_map(void)
+{
+    if (banking_mode == 0)   // high 2 bits select the ROM bank in 0x4000 - 0x7FFF only
+    {
+        map_ROM(0, RAM_bank << 5 | ROM_bank);
+        map_RAM(0);
+    }
+    else                     // high 2 bits also select the ROM bank in 0x0000 - 0x3FFF and the RAM bank
+    {
+        map_ROM(RAM_bank << 5, RAM_bank << 5 | ROM_bank);
+        map_RAM(RAM_bank);
+    }
+}
+
+static void MBC1_reset(void)
+{
+    ROM_bank = 1;
+    MBC1_map();
+}
+
+static void MBC1_write(uint16_t address, uint8_t data)
+{
+    if (address <= 0x1FFF)
+        enable_RAM(data);
+    else if (address <= 0x3FFF)
+        ROM_bank = data & 0x1F ? data & 0x1F : 0x01;   // low 5 bits of ROM bank number, bank 0 selects bank 1
+    else if (address <= 0x5FFF)
+        RAM_bank = data & 0x03;                        // RAM bank or high 2 bits of ROM bank number
+    else
+        banking_mode = data & 0x01;
+
+    MBC1_map();
+}
+
+/**** MBC2 - max 256 KB ROM + 512 x 4 bits RAM ****/
+static void MBC2_map(void)
+{
+    map_ROM(0, ROM_bank);
+}
+
+static void MBC2_reset(void)
+{
+    ROM_bank = 1;
+    MBC2_map();
+}
+
+static void MBC2_write(uint16_t address, uint8_t data)
+{
+    if (address > 0x3FFF)
+        return;
+
+    if ((address & 0x0100) == 0)
+        enable_RAM(data);
+    else   // select ROM bank
+    {
+        ROM_bank = data & 0x0F ? data & 0x0F : 0x01;
+        MBC2_map();
+    }
+}
+
+static uint8_t MBC2_read_RAM(uint16_t address)
+{
+    if (!RAM_enabled)
+        return 0xFF;
+
+    return 0xF0 | cartridge->RAM[address & (MBC2_RAM_SIZE - 1)];   // 512 bytes mirrored through 0xA000 - 0xBFFF, upper 4 bits open
+}
+
+static void MBC2_write_RAM(uint16_t address, uint8_t data)
+{
+    if (RAM_enabled)
+    {
+        cartridge->RAM[address & (MBC2_RAM_SIZE - 1)] = data & 0x0F;
+        dirty_pages |= 1;
+    }
+}
+
+/**** MBC3 - max 2 MB ROM + 32 KB RAM + real time clock ****/
+enum RTC_Register { RTC_S, RTC_M, RTC_H, RTC_DL, RTC_DH };
+
+#define RTC_HALT      0x40     // DH bit 6
+#define RTC_CARRY     0x80     // DH bit 7: day counter overflow
+
+// the clock counts emulated time, so it runs at the emulation speed and replays deterministically - with a
+// battery it is kept in the .sav file and advanced by the wall clock time the emulator was off when loaded
+static struct RTC
+{
+    uint64_t seconds;          // seconds counted at clock cycle base
+    uint64_t base;
+    uint8_t DH;                // halt and carry flags (day counter bit 8 is kept in seconds)
+    uint8_t latched[5];
+    uint8_t latch;             // last value written to 0x6000 - 0x7FFF
+} RTC;
+
+static void RTC_sync(void)
+{
+    if (!(RTC.DH & RTC_HALT))
+        RTC.seconds += (clock_cycles - RTC.base) / CLOCK_FREQUENCY;
+
+    RTC.base = clock_cycles - (clock_cycles - RTC.base) % CLOCK_FREQUENCY;   // keep the fraction of the running second
+
+    if (RTC.seconds >= 512 * 86400)   // 9 bit day counter overflow
+    {
+        RTC.seconds %= 512 * 86400;
+        RTC.DH |= RTC_CARRY;
+    }
+}
+
+static void RTC_registers(uint8_t registers[5])
+{
+    RTC_sync();
+
+    uint32_t days = RTC.seconds / 86400;
+
+    registers[RTC_S] = RTC.seconds % 60;
+    registers[RTC_M] = RTC.seconds / 60 % 60;
+    registers[RTC_H] = RTC.seconds / 3600 % 24;
+    registers[RTC_DL] = days & 0xFF;
+    registers[RTC_DH] = (RTC.DH & (RTC_HALT | RTC_CARRY)) | (days >> 8 & 0x01);
+}
+
+static void RTC_latch(void)
+{
+    RTC_registers(RTC.latched);
+}
+
+static void RTC_set(const uint8_t registers[5])
+{
+    uint64_t days = registers[RTC_DL] | (registers[RTC_DH] & 0x01) << 8;
+
+    RTC.seconds = ((days * 24 + (registers[RTC_H] & 0x1F)) * 60 + (registers[RTC_M] & 0x3F)) * 60 + (registers[RTC_S] & 0x3F);
+    RTC.DH = registers[RTC_DH] & (RTC_HALT | RTC_CARRY);
+}
 
-    FILE *rom = fopen(rom_path, "rb");
-    if (!rom)
+static void RTC_write(enum RTC_Register reg, uint8_t data)
+{
+    RTC_sync();
+
+    uint64_t days = RTC.seconds / 86400, hours = RTC.seconds / 3600 % 24, minutes = RTC.seconds / 60 % 60, seconds = RTC.seconds % 60;
+
+    switch (reg)
+    {
+        case RTC_S:  seconds = data & 0x3F; RTC.base = clock_cycles; break;   // writing seconds resets the divider
+        case RTC_M:  minutes = data & 0x3F; break;
+        case RTC_H:  hours = data & 0x1F; break;
+        case RTC_DL: days = (days & 0x100) | data; break;
+        case RTC_DH: days = (days & 0xFF) | (data & 0x01) << 8; RTC.DH = data & (RTC_HALT | RTC_CARRY); break;
+    }
+
+    RTC.seconds = ((days * 24 + hours) * 60 + minutes) * 60 + seconds;
+    RTC.latched[reg] = data;
+}
+
+static void MBC3_map(void)
+{
+    map_ROM(0, ROM_bank);
+
+    if (RAM_bank <= 0x03)
+        map_RAM(RAM_bank);
+    else
+        RAM_window = NULL;   // RTC register selected
+}
+
+static void MBC3_reset(void)
+{
+    ROM_bank = 1;
+    memset(&RTC, 0, sizeof RTC);
+    RTC.base = clock_cycles;
+    RTC.latch = 0xFF;
+    MBC3_map();
+}
+
+static void MBC3_write(uint16_t address, uint8_t data)
+{
+    if (address <= 0x1FFF)
+        enable_RAM(data);   // also enables the RTC registers
+    else if (address <= 0x3FFF)
+        ROM_bank = data & 0x7F ? data & 0x7F : 0x01;
+    else if (address <= 0x5FFF)
+        RAM_bank = data & 0x0F;   // 0x00 - 0x03 RAM bank, 0x08 - 0x0C RTC register
+    else
+    {
+        if (RTC.latch == 0x00 && data == 0x01)   // writing 0 then 1 latches the clock into the RTC registers
+            RTC_latch();
+        RTC.latch = data;
+    }
+
+    MBC3_map();
+}
+
+static uint8_t MBC3_read_RAM(uint16_t address)
+{
+    if (RAM_enabled && RAM_bank >= 0x08 && RAM_bank <= 0x0C)
+        return RTC.latched[RAM_bank - 0x08];
+
+    return 0xFF;
+}
+
+static void MBC3_write_RAM(uint16_t address, uint8_t data)
+{
+    if (RAM_enabled && RAM_bank >= 0x08 && RAM_bank <= 0x0C)
+        RTC_write(RAM_bank - 0x08, data);
+}
+
+/**** MBC5 - max 8 MB ROM + 128 KB RAM ****/
+static void MBC5_map(void)
+{
+    map_ROM(0, ROM_bank);
+    map_RAM(RAM_bank);
+}
+
+static void MBC5_reset(void)
+{
+    ROM_bank = 1;
+    MBC5_map();
+}
+
+static void MBC5_write(uint16_t address, uint8_t data)
+{
+    if (address <= 0x1FFF)
+        enable_RAM(data);
+    else if (address <= 0x2FFF)
+        ROM_bank = (ROM_bank & 0x100) | data;               // low 8 bits of ROM bank number (bank 0 can be selected)
+    else if (address <= 0x3FFF)
+        ROM_bank = (ROM_bank & 0xFF) | (data & 0x01) << 8;  // bit 8 of ROM bank number
+    else if (address <= 0x5FFF)
+        RAM_bank = data & 0x0F;
+
+    MBC5_map();
+}
+
+static const Mapper ROM_only = { "ROM only", ROM_only_reset, ROM_only_map, NULL, NULL, NULL };   // no MBC: writes are ignored
+static const Mapper MBC1 = { "MBC1", MBC1_reset, MBC1_map, MBC1_write, NULL, NULL };
+static const Mapper MBC2 = { "MBC2", MBC2_reset, MBC2_map, MBC2_write, MBC2_read_RAM, MBC2_write_RAM };
+static const Mapper MBC3 = { "MBC3", MBC3_reset, MBC3_map, MBC3_write, MBC3_read_RAM, MBC3_write_RAM };
+static const Mapper MBC5 = { "MBC5", MBC5_reset, MBC5_map, MBC5_write, NULL, NULL };
+
+static const struct CartridgeType
+{
+    const Mapper *mapper;
+    int battery;
+    int timer;   // MBC3 real time clock
+} cartridge_types[0x100] =   // indexed by cartridge type (header 0x0147)
+{
+    [0x00] = { &ROM_only, 0 },   // ROM only
+    [0x01] = { &MBC1, 0 },       // MBC1
+    [0x02] = { &MBC1, 0 },       // MBC1 + RAM
+    [0x03] = { &MBC1, 1 },       // MBC1 + RAM + battery
+    [0x05] = { &MBC2, 0 },       // MBC2
+    [0x06] = { &MBC2, 1 },       // MBC2 + battery
+    [0x08] = { &ROM_only, 0 },   // ROM + RAM
+    [0x09] = { &ROM_only, 1 },   // ROM + RAM + battery
+    [0x0F] = { &MBC3, 1, 1 },    // MBC3 + timer + battery
+    [0x10] = { &MBC3, 1, 1 },    // MBC3 + timer + RAM + battery
+    [0x11] = { &MBC3, 0 },       // MBC3
+    [0x12] = { &MBC3, 0 },       // MBC3 + RAM
+    [0x13] = { &MBC3, 1 },       // MBC3 + RAM + battery
+    [0x19] = { &MBC5, 0 },       // MBC5
+    [0x1A] = { &MBC5, 0 },       // MBC5 + RAM
+    [0x1B] = { &MBC5, 1 },       // MBC5 + RAM + battery
+    [0x1C] = { &MBC5, 0 },       // MBC5 + rumble
+    [0x1D] = { &MBC5, 0 },       // MBC5 + rumble + RAM
+    [0x1E] = { &MBC5, 1 },       // MBC5 + rumble + RAM + battery
+};
+
+static const uint32_t RAM_lengths[] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };   // indexed by RAM size (header 0x0149)
+
+/**** battery backed RAM ****/
+// the .sav file is mapped shared as the cartridge RAM itself: writes land in the page cache with no copy and
+// survive a crash of the emulator, msync only schedules (or on exit waits for) the write back of dirty pages
+static int load_save(const char *save_path)
+{
+    int save = open(save_path, O_RDWR | O_CREAT, 0644);
+    struct stat save_stat;
+    if (save == -1 || fstat(save, &save_stat) == -1)
     {
-        printf("error loading ROM");
+        printf("error opening save file: %s", save_path);
+        if (save != -1)
+            close(save);
         return 0;
     }
 
-    fseek(rom, 0x134, SEEK_SET);
-    fread(cartridge->title, 16, 1, rom);
-    fseek(rom, 3, SEEK_CUR);
-    uint8_t MBC;
-    fread(&MBC, 1, 1, rom);
-    cartridge->MBC = MBC;
-    fread(&cartridge->ROM_size, 1, 1, rom);
-    fread(&cartridge->RAM_size, 1, 1, rom);
+    cartridge->save_length = cartridge->RAM_length + (cartridge->RTC_footer ? RTC_FOOTER_SIZE : 0);
 
-    fseek(rom, 0, SEEK_SET);
-    cartridge->ROM = (uint8_t*)malloc(32 * 1024 << cartridge->ROM_size);
-    fread(cartridge->ROM, 32 * 1024 << cartridge->ROM_size, 1, rom);
+    if (save_stat.st_size < cartridge->save_length && ftruncate(save, cartridge->save_length) == -1)   // new save: zero filled
+    {
+        printf("error resizing save file: %s", save_path);
+        close(save);
+        return 0;
+    }
 
-    switch (cartridge->RAM_size)
+    cartridge->RAM = (uint8_t*)mmap(NULL, cartridge->save_length, PROT_READ | PROT_WRITE, MAP_SHARED, save, 0);
+    close(save);
+    if (cartridge->RAM == MAP_FAILED)
     {
-        case 0:   // no RAM
-            cartridge->RAM = NULL;  
-            break;
-        case 1:   // 2 KB RAM (partial bank)
-            cartridge->RAM = (uint8_t*)malloc(2 * 1024);
-            break; 
-        case 2:   // 8 KB RAM (1 bank)
-            cartridge->RAM = (uint8_t*)malloc(8 * 1024);
-            break;
-        case 3:   // 32 KB RAM (4 banks)
-            cartridge->RAM = (uint8_t*)malloc(32 * 1024);
-            break;
-        case 4:   // 128 KB RAM (16 banks)
-            cartridge->RAM = (uint8_t*)malloc(128 * 1024);
-            break;
-        case 5:   // 64 KB RAM (8 banks)
-            cartridge->RAM = (uint8_t*)malloc(64 * 1024);
-            break;
+        printf("error mapping save file: %s", save_path);
+        cartridge->RAM = NULL;
+        return 0;
     }
-    
+
+    cartridge->battery = 1;
+    dirty_pages = 0;
+    cartridge_next_flush = clock_cycles + SAVE_FLUSH_CYCLES;
+
     return 1;
 }
 
-// MBC1
-static uint8_t ROM_bank = 1;  
-static enum Banking_Mode { ROM_BANKING_MODE, RAM_BANKING_MODE } banking_mode = ROM_BANKING_MODE;
-static int RAM_enabled = 0;
-static uint8_t RAM_bank = 0;
+/**** real time clock in the .sav file ****/
+// customary 48 byte footer: S, M, H, DL, DH and the latched S - DH as 32 bit little-endian values,
+// then the host UNIX time it was written at as a 64 bit little-endian value
+static void put_le(uint8_t *p, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        p[i] = value >> i * 8 & 0xFF;
+}
 
-uint8_t cartridge_read(uint16_t address)
+static uint64_t get_le(const uint8_t *p, int bytes)
 {
-    switch (cartridge->MBC)
+    uint64_t value = 0;
+
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)p[i] << i * 8;
+
+    return value;
+}
+
+static void RTC_save(void)
+{
+    uint8_t *footer = cartridge->RAM + cartridge->RAM_length;
+    uint8_t registers[5];
+
+    RTC_registers(registers);
+
+    for (int i = 0; i < 5; i++)
     {
-        case ROM_ONLY:
-            return cartridge->ROM[address];
+        put_le(footer + i * 4, registers[i], 4);
+        put_le(footer + 20 + i * 4, RTC.latched[i], 4);
+    }
+    put_le(footer + 40, (uint64_t)time(NULL), 8);
+}
 
-            break;
+static void RTC_restore(void)
+{
+    const uint8_t *footer = cartridge->RAM + cartridge->RAM_length;
+    int64_t saved_time = (int64_t)get_le(footer + 40, 8);
+    uint8_t registers[5];
 
-        case MBC1:
-        case MBC1_RAM:
-        case MBC1_RAM_BATTERY:
-            if (address >= 0x0000 && address <= 0x3FFF)       // fixed 16 KB ROM bank
-                return cartridge->ROM[address];
-            else if (address >= 0x4000 && address <= 0x7FFF)  // switchable 16 KB ROM bank 
-            {
-                uint32_t ROM_bank_address = ROM_bank * 0x4000;
-                return cartridge->ROM[ROM_bank_address + (address & 0x3FFF)];
-            }
-            else if (address >= 0xA000 && address <= 0xBFFF)  // external RAM
-                return cartridge->RAM[address & 0x1FFF];
+    if (!saved_time)   // new save
+        return;
 
-            break;
+    for (int i = 0; i < 5; i++)
+    {
+        registers[i] = get_le(footer + i * 4, 4);
+        RTC.latched[i] = get_le(footer + 20 + i * 4, 4);
+    }
+    RTC_set(registers);
 
-        case MBC2_BATTERY:
-            if (address >= 0x0000 && address <= 0x3FFF)
-                return cartridge->ROM[address];
-            else
-            {
-                uint32_t ROM_bank_address = ROM_bank * 0x4000;
-                return cartridge->ROM[ROM_bank_address + (address & 0x3FFF)];
-            }
+    int64_t now = (int64_t)time(NULL);
+    if (!(RTC.DH & RTC_HALT) && now > saved_time)
+        RTC.seconds += now - saved_time;   // the clock kept running while the emulator was off
 
-            break;
+    RTC.base = clock_cycles;
+    RTC_sync();   // day counter overflow
+}
+
+// write back the pages of battery backed RAM changed since the last flush - wait: block until they are on disk
+void cartridge_flush(int wait)
+{
+    if (!cartridge || !cartridge->battery)
+        return;
+
+    cartridge_next_flush = clock_cycles + SAVE_FLUSH_CYCLES;
+
+    uintptr_t page_mask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+
+    for (int page = 0; dirty_pages; page++)
+        if (dirty_pages & 1u << page)
+        {
+            uint8_t *start = cartridge->RAM + page * SAVE_PAGE_SIZE;
+            uint8_t *aligned = (uint8_t*)((uintptr_t)start & ~page_mask);   // msync needs a system page aligned address
+            size_t length = SAVE_PAGE_SIZE < cartridge->RAM_length ? SAVE_PAGE_SIZE : cartridge->RAM_length;
+
+            msync(aligned, start - aligned + length, wait ? MS_SYNC : MS_ASYNC);
+            dirty_pages &= ~(1u << page);
+        }
+
+    if (cartridge->RTC_footer)   // the clock moves every second, its footer is always written back
+    {
+        uint8_t *footer = cartridge->RAM + cartridge->RAM_length;
+        uint8_t *aligned = (uint8_t*)((uintptr_t)footer & ~page_mask);
+
+        RTC_save();
+        msync(aligned, footer - aligned + RTC_FOOTER_SIZE, wait ? MS_SYNC : MS_ASYNC);
     }
 }
 
-void cartridge_write(uint16_t address, uint8_t data)
+// the cartridge is loaded before gameboy_init restarts the clock (a previous machine may have left it running):
+// the time the real time clock counts from and the next flush are rebased onto the new clock, the time restored
+// from the save is kept
+void cartridge_clock_reset(void)
+{
+    if (!cartridge)
+        return;
+
+    RTC.base = clock_cycles;
+
+    if (cartridge->battery)
+        cartridge_next_flush = clock_cycles + SAVE_FLUSH_CYCLES;
+}
+
+// instances cloned from one loaded cartridge must not share (and clobber) its .sav file
+void cartridge_detach_save(void)
+{
+    if (!cartridge || !cartridge->battery)
+        return;
+
+    uint8_t *RAM = (uint8_t*)malloc(cartridge->RAM_length);
+    memcpy(RAM, cartridge->RAM, cartridge->RAM_length);
+    munmap(cartridge->RAM, cartridge->save_length);
+
+    cartridge->RAM = RAM;
+    cartridge->battery = 0;
+    cartridge->RTC_footer = 0;   // the clock keeps its restored time
+    dirty_pages = 0;
+    cartridge_next_flush = UINT64_MAX;
+
+    cartridge->mapper->map();   // RAM window pointed into the old mapping
+}
+
+/**** compressed ROMs ****/
+typedef struct ROMStream
+{
+    int file;
+    int stored;                // zip entry stored without compression
+    z_stream z;
+    uint8_t input[0x10000];
+} ROMStream;
+
+// decompress up to length bytes into output, reading the compressed file as needed
+static size_t stream_read(ROMStream *stream, uint8_t *output, size_t length)
 {
-    switch (cartridge->MBC)
+    z_stream *z = &stream->z;
+
+    z->next_out = output;
+    z->avail_out = length;
+
+    while (z->avail_out)
     {
-        case ROM_ONLY:
+        if (!z->avail_in)
+        {
+            ssize_t result = read(stream->file, stream->input, sizeof stream->input);
+            if (result <= 0)
+                break;
 
-            break;
+            z->next_in = stream->input;
+            z->avail_in = result;
+        }
 
-        case MBC1:  // max 2 MB ROM + 32 KB RAM
-        case MBC1_RAM:
-        case MBC1_RAM_BATTERY:
-            if (address >= 0x0000 && address <= 0x1FFF)
-            {
-                if ((data & 0x0F) == 0x0A)
-                    RAM_enabled = 1;
-                else
-                    RAM_enabled = 0;
-            }
-            else if (address >= 0x2000 && address <= 0x3FFF)
-            {
-                ROM_bank = ROM_bank & 0x60 | data & 0x1F;     // low 5 bits of ROM bank number
+        if (stream->stored)
+        {
+            uInt count = z->avail_in < z->avail_out ? z->avail_in : z->avail_out;
 
-                if (data == 0x00)
-                    ROM_bank = ROM_bank & 0x60 | 0x01;
-            }
-            else if (address >= 0x4000 && address <= 0x5FFF)
-            {
-                if (banking_mode == ROM_BANKING_MODE)
-                    ROM_bank = ROM_bank & 0x1F | (data & 0x03) << 5;     // high 2 bits of ROM bank number
-                else  // RAM_BANKING_MODE
-                    RAM_bank = data & 0x03;
-            }
-            else if (address >= 0x6000 && address <= 0x7FFF)
-            {
-                if ((data & 0x01) == 0)
-                    banking_mode = ROM_BANKING_MODE;
-                else
-                    banking_mode = RAM_BANKING_MODE;
-            }
-            else if (address >= 0xA000 && address <= 0xBFFF)  // external RAM
-                cartridge->RAM[address & 0x1FFF] = data;
+            memcpy(z->next_out, z->next_in, count);
+            z->next_in += count, z->avail_in -= count;
+            z->next_out += count, z->avail_out -= count;
+        }
+        else
+        {
+            int result = inflate(z, Z_NO_FLUSH);
+
+            if (result == Z_STREAM_END || (result != Z_OK && result != Z_BUF_ERROR))
+                break;
+        }
+    }
+
+    return length - z->avail_out;
+}
+
+// gzip file or first entry of a zip archive, streamed straight into an anonymous mapping: the header comes
+// out of the first chunk and sizes the ROM, the rest is decompressed in place with no temporary file
+static int inflate_ROM(int file, int zip)
+{
+    static ROMStream stream;
+    uint8_t header[0x150];
+
+    memset(&stream, 0, sizeof stream);
+    stream.file = file;
+
+    if (zip)   // local file header
+    {
+        uint8_t local[30];
+
+        if (read(file, local, sizeof local) != sizeof local || ((local[8] | local[9] << 8) != 0 && (local[8] | local[9] << 8) != Z_DEFLATED))
+        {
+            printf("error loading ROM: unsupported zip archive");
+            return 0;
+        }
+
+        stream.stored = (local[8] | local[9] << 8) == 0;
+        lseek(file, sizeof local + (local[26] | local[27] << 8) + (local[28] | local[29] << 8), SEEK_SET);   // skip file name and extra field
+    }
+
+    if (inflateInit2(&stream.z, zip ? -MAX_WBITS : 16 + MAX_WBITS) != Z_OK)   // raw deflate or gzip wrapper
+        return 0;
+
+    uint8_t ROM_size = 0xFF;
+    if (stream_read(&stream, header, sizeof header) == sizeof header)
+        ROM_size = header[0x148];
+
+    if (ROM_size > 8)
+    {
+        printf("error loading ROM: bad compressed ROM");
+        inflateEnd(&stream.z);
+        return 0;
+    }
+
+    cartridge->ROM_length = 32 * 1024 << ROM_size;
+    cartridge->ROM = (uint8_t*)mmap(NULL, cartridge->ROM_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (cartridge->ROM == MAP_FAILED)
+    {
+        printf("error mapping ROM");
+        cartridge->ROM = NULL;
+        inflateEnd(&stream.z);
+        return 0;
+    }
+    cartridge->ROM_map_length = cartridge->ROM_length;
+
+    memcpy(cartridge->ROM, header, sizeof header);
+    size_t length = sizeof header + stream_read(&stream, cartridge->ROM + sizeof header, cartridge->ROM_length - sizeof header);
+
+    inflateEnd(&stream.z);
+    mprotect(cartridge->ROM, cartridge->ROM_length, PROT_READ);
+
+    if (length != cartridge->ROM_length)
+    {
+        printf("error loading ROM: compressed ROM smaller than ROM size in header");
+        return 0;
+    }
+
+    return 1;
+}
+
+/**** patches ****/
+static int patch_file;            // ROM file mapped again as the patch target (-1: compressed ROM, copied)
+static uint8_t *patched_ROM;
+static size_t patched_length;
+
+// private writable mapping of the ROM file: pages the patch leaves alone stay shared with the page cache
+static uint8_t *patch_target(size_t length)
+{
+    patched_length = length > cartridge->ROM_length ? length : cartridge->ROM_length;
+    patched_ROM = (uint8_t*)mmap(NULL, patched_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);   // room to grow
+    if (patched_ROM == MAP_FAILED)
+        return patched_ROM = NULL;
+
+    if (patch_file == -1)
+        memcpy(patched_ROM, cartridge->ROM, cartridge->ROM_length);
+    else if (mmap(patched_ROM, cartridge->ROM_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, patch_file, 0) == MAP_FAILED)
+    {
+        munmap(patched_ROM, patched_length);
+        return patched_ROM = NULL;
+    }
+
+    return patched_ROM;
+}
+
+static int patch_ROM(const char *patch_path, int file)
+{
+    patch_file = file;
+    patched_ROM = NULL;
+
+    size_t length = patch_apply(patch_path, cartridge->ROM, cartridge->ROM_length, patch_target);
+    if (!length)
+    {
+        if (patched_ROM)
+            munmap(patched_ROM, patched_length);
+        return 0;
+    }
 
+    mprotect(patched_ROM, patched_length, PROT_READ);
+    munmap(cartridge->ROM, cartridge->ROM_map_length);
+    cartridge->ROM = patched_ROM;
+    cartridge->ROM_length = length;   // a shrinking patch leaves source bytes past the target in the mapping
+    cartridge->ROM_map_length = patched_length;
+
+    return 1;
+}
+
+int cartridge_load(const char *rom_name, const char *patch_path)
+{
+    static const char *const extensions[] = { ".gb", ".gb.gz", ".zip" };
+    static const char *const patch_extensions[] = { ".ips", ".bps" };
+    char rom_path[PATH_MAX], patch_name[PATH_MAX];
+
+    for (int i = 0; i < sizeof extensions / sizeof extensions[0]; i++)   // plain ROM first, then compressed
+    {
+        if (snprintf(rom_path, sizeof rom_path, "ROMs/%s%s", rom_name, extensions[i]) >= sizeof rom_path)
+        {
+            printf("error loading ROM: name too long");
+            return 0;
+        }
+
+        if (access(rom_path, F_OK) == 0)
             break;
+    }
+
+    for (int i = 0; i < 2 && !patch_path; i++)   // soft patch ROMs/<rom_name>.ips or .bps when present
+    {
+        snprintf(patch_name, sizeof patch_name, "ROMs/%s%s", rom_name, patch_extensions[i]);
+
+        if (access(patch_name, F_OK) == 0)
+            patch_path = patch_name;
+    }
+
+    return cartridge_load_file(rom_path, patch_path);
+}
+
+int cartridge_load_file(const char *rom_path, const char *patch_path)
+{
+    cartridge_unload();   // loading over a running cartridge releases its ROM and flushes its save first
+    cartridge = (Cartridge*)calloc(1, sizeof(Cartridge));
+
+    int rom = open(rom_path, O_RDONLY);
+    struct stat rom_stat;
+    uint8_t magic[4] = { 0 };
+    if (rom == -1 || fstat(rom, &rom_stat) == -1 || pread(rom, magic, sizeof magic, 0) == -1)
+    {
+        printf("error loading ROM: %s\n", rom_path);
+        if (rom != -1)
+            close(rom);
+        cartridge_unload();
+        return 0;
+    }
+
+    if ((magic[0] == 0x1F && magic[1] == 0x8B) || memcmp(magic, "PK\3\4", 4) == 0)   // gzip or zip
+    {
+        int loaded = inflate_ROM(rom, magic[0] == 'P');
+        close(rom);
+        rom = -1;
+        if (!loaded)
+        {
+            cartridge_unload();
+            return 0;
+        }
+    }
+    else
+    {
+        // map the ROM read-only: pages are faulted in on first access and every instance
+        // running the same ROM file shares the same physical pages through the page cache
+        cartridge->ROM = rom_stat.st_size >= 0x150 ? (uint8_t*)mmap(NULL, rom_stat.st_size, PROT_READ, MAP_PRIVATE, rom, 0) : MAP_FAILED;
+        if (cartridge->ROM == MAP_FAILED)
+        {
+            printf("error mapping ROM");
+            close(rom);
+            cartridge->ROM = NULL;
+            cartridge_unload();
+            return 0;
+        }
+        cartridge->ROM_length = cartridge->ROM_map_length = rom_stat.st_size;
+    }
+
+    int patched = !patch_path || patch_ROM(patch_path, rom);   // before the header is read: patches may change it
+    if (rom != -1)
+        close(rom);
+    if (!patched)
+    {
+        cartridge_unload();
+        return 0;
+    }
+
+    // cartridge header 0x0134 - 0x014F
+    const uint8_t *header = cartridge->ROM + 0x134;
+    memcpy(cartridge->title, header, 16);   // 0x0134 - 0x0143 title
+    cartridge->type = header[0x13];         // 0x0147 cartridge type
+    cartridge->ROM_size = header[0x14];     // 0x0148 ROM size
+    cartridge->RAM_size = header[0x15];     // 0x0149 RAM size
+
+    if (cartridge->ROM_size > 8 || cartridge->ROM_length < 32 * 1024 << cartridge->ROM_size)
+    {
+        printf("error loading ROM: file smaller than ROM size in header");
+        cartridge_unload();
+        return 0;
+    }
+    cartridge->ROM_banks = 2 << cartridge->ROM_size;
+
+    if (!(cartridge->mapper = cartridge_types[cartridge->type].mapper))
+    {
+        printf("error loading ROM: unsupported cartridge type 0x%02X", cartridge->type);
+        cartridge_unload();
+        return 0;
+    }
+
+    if (cartridge->mapper == &MBC2)
+        cartridge->RAM_length = MBC2_RAM_SIZE;
+    else if (cartridge->RAM_size < sizeof RAM_lengths / sizeof RAM_lengths[0])
+    {
+        cartridge->RAM_length = RAM_lengths[cartridge->RAM_size];   // the .sav file has the size of the RAM, 2 KB included
+        cartridge->RAM_banks = (cartridge->RAM_length + RAM_BANK_SIZE - 1) / RAM_BANK_SIZE;
+    }
+    RAM_mask = cartridge->RAM_length < RAM_BANK_SIZE ? cartridge->RAM_length - 1 : RAM_BANK_SIZE - 1;
+
+    cartridge->RTC_footer = cartridge_types[cartridge->type].timer;
 
-        case MBC2_BATTERY:
-            if (address >= 0x0000 && address <= 0x3FFF)
+    if ((cartridge->RAM_length || cartridge->RTC_footer) && cartridge_types[cartridge->type].battery)
+    {
+        char save_path[PATH_MAX];   // ROM path with the extension replaced by .sav
+        int base = strlen(rom_path);
+        if (base > 3 && strcmp(rom_path + base - 3, ".gz") == 0)   // game.gb.gz: game.sav
+            base -= 3;
+        for (int i = base - 1; i >= 0 && rom_path[i] != '/'; i--)   // drop the extension
+            if (rom_path[i] == '.')
             {
-                if ((address & 0x0100) == 0)
-                {
-                    if (data == 0x0A)
-                        RAM_enabled = 1; 
-                    else
-                        RAM_enabled = 0;
-                }
-                else // select ROM bank
-                    if (data == 0)
-                        ROM_bank = 1;
-                    else
-                        ROM_bank = data & 0x0F;
+                base = i;
+                break;
             }
+        snprintf(save_path, sizeof save_path, "%.*s.sav", base, rom_path);
 
-            break;
+        if (!load_save(save_path))
+        {
+            cartridge_unload();
+            return 0;
+        }
+    }
+    else if (cartridge->RAM_length)
+        cartridge->RAM = (uint8_t*)calloc(cartridge->RAM_length, 1);
+
+    RAM_enabled = 0;
+    ROM_bank = 0;
+    RAM_bank = 0;
+    banking_mode = 0;
+    cartridge->mapper->reset();
+
+    if (cartridge->battery && cartridge->RTC_footer)
+        RTC_restore();
+    
+    return 1;
+}
+
+// MBC registers and clock - the RAM contents are not part of the snapshot (battery backed RAM lives in the .sav file)
+void cartridge_state(State *state)
+{
+    state_io(state, &RAM_enabled, sizeof RAM_enabled);
+    state_io(state, &ROM_bank, sizeof ROM_bank);
+    state_io(state, &RAM_bank, sizeof RAM_bank);
+    state_io(state, &banking_mode, sizeof banking_mode);
+    if (!state->boot)   // the MBC3 clock belongs to the .sav file, a cached boot keeps the one restored from it
+        state_io(state, &RTC, sizeof RTC);
+
+    if (state->loading)
+        cartridge->mapper->map();
+}
+
+uint64_t cartridge_hash(void)
+{
+    return rom_hash(cartridge->ROM, cartridge->ROM_length);
+}
+
+void cartridge_unload(void)
+{
+    if (!cartridge)
+        return;
+
+    if (cartridge->ROM)
+        munmap(cartridge->ROM, cartridge->ROM_map_length);
+
+    if (cartridge->battery)
+    {
+        if (cartridge->RTC_footer)
+            RTC_save();
+        msync(cartridge->RAM, cartridge->save_length, MS_SYNC);   // make sure everything written is on disk
+        dirty_pages = 0;
+        munmap(cartridge->RAM, cartridge->save_length);
+        cartridge_next_flush = UINT64_MAX;
+    }
+    else
+        free(cartridge->RAM);
+    free(cartridge);
+    cartridge = NULL;
+}
+
+uint8_t cartridge_read(uint16_t address)
+{
+    return ROM_window[address >> 14][address & 0x3FFF];
+}
+
+void cartridge_write(uint16_t address, uint8_t data)
+{
+    if (cartridge->mapper->write)
+        cartridge->mapper->write(address, data);
+}
+
+uint8_t cartridge_read_RAM(uint16_t address)
+{
+    if (RAM_window)
+        return RAM_window[address & RAM_mask];
+    else if (cartridge->mapper->read_RAM)
+        return cartridge->mapper->read_RAM(address);
+    else
+        return 0xFF;   // RAM disabled or absent
+}
+
+void cartridge_write_RAM(uint16_t address, uint8_t data)
+{
+    if (RAM_window)
+    {
+        RAM_window[address & RAM_mask] = data;
+
+        if (cartridge->battery)
+            dirty_pages |= 1u << (RAM_window - cartridge->RAM + (address & RAM_mask)) / SAVE_PAGE_SIZE;
     }
+    else if (cartridge->mapper->write_RAM)
+        cartridge->mapper->write_RAM(address, data);
 }
\ No newline at end of file
@@ -1,6 +1,20 @@
 #include <stdint.h>
+#include "state.h"
 
-int cartridge_load(const char *rom_name);
+int cartridge_load(const char *rom_name, const char *patch_path);    // ROMs/<rom_name>.gb, .gb.gz or .zip - patch NULL: ROMs/<rom_name>.ips or .bps if present
+int cartridge_load_file(const char *rom_path, const char *patch_path);   // plain, gzip or zip ROM file - IPS or BPS patch (optional)
+void cartridge_unload(void);   // battery backed RAM is written back to the .sav file
 
-uint8_t cartridge_read(uint16_t address);
-void cartridge_write(uint16_t address, uint8_t data);
\ No newline at end of file
+extern uint64_t cartridge_next_flush;   // clock cycle battery backed RAM is written back at (UINT64_MAX: no battery)
+void cartridge_flush(int wait);
+void cartridge_detach_save(void);   // battery backed RAM becomes a private copy, never written back to the .sav file
+void cartridge_clock_reset(void);   // clock_cycles restarted from 0 after the cartridge was loaded: rebase its clock and flush
+
+void cartridge_state(State *state);
+uint64_t cartridge_hash(void);   // FNV-1a 64 of the ROM, as in the ROM library index
+
+uint8_t cartridge_read(uint16_t address);               // ROM 0x0000 - 0x7FFF
+void cartridge_write(uint16_t address, uint8_t data);   // MBC registers 0x0000 - 0x7FFF
+
+uint8_t cartridge_read_RAM(uint16_t address);           // external RAM 0xA000 - 0xBFFF
+void cartridge_write_RAM(uint16_t address, uint8_t data);
\ No newline at end of file
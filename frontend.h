@@ -0,0 +1,19 @@
+#ifndef __FRONTEND_H__
+#define __FRONTEND_H__
+
+#include <stdint.h>
+
+// front end callbacks - the emulation core never talks to a display, audio device or keyboard directly
+typedef struct Frontend
+{
+    void (*video_frame)(const uint32_t *pixels);                  // completed DISPLAY_WIDTH x DISPLAY_HEIGHT frame (0x00RRGGBB), called at VBLANK
+    void (*audio_samples)(const int16_t *samples, int length);   // interleaved stereo signed 16-bit samples @ sampling frequency given to gameboy_init
+    uint8_t (*input)(void);                                       // currently pressed buttons (enum Button bits), sampled once per frame on the emulation thread
+    void (*channel_samples)(const int16_t *samples, int length); // optional: interleaved channel 1 -- 4 DAC outputs (stems), not synthesized when NULL
+    void (*serial_byte)(uint8_t data);                            // optional: byte sent out with the internal clock (test ROM output)
+    void (*breakpoint)(void);                                     // optional: LD B,B executed (debug breakpoint used by test ROMs)
+} Frontend;
+
+extern Frontend frontend;
+
+#endif  // __FRONTEND_H__
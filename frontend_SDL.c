@@ -0,0 +1,457 @@
+#include "frontend_SDL.h"
+#include "gameboy.h"
+#include "PPU.h"
+#include "APU.h"
+#include "joypad.h"
+#include "SDL2/SDL.h"
+#include <string.h>
+
+#define AUDIO_CHUNK_CYCLES               (CLOCK_FREQUENCY / 1024)   // cycles emulated at a time by the audio callback (~1 ms)
+#define AUDIO_RING_MAX_SIZE              0x40000    // bytes - power of two
+#define APU_BUFFER_SIZE                  1024       // max interleaved samples handed over at a time by the APU
+#define MAX_RATE_DELTA                   0.005      // max resampling ratio adjustment for dynamic rate control
+#define STRETCH_GRAIN                    2048       // interleaved samples per fast forward grain (~21 ms at 48 kHz)
+#define STRETCH_OVERLAP                  512        // interleaved samples crossfaded between consecutive grains (~5 ms)
+
+static void video_frame(const uint32_t *pixels);
+static void audio_samples(const int16_t *samples, int length);
+static uint8_t input(void);
+
+const Frontend frontend_SDL = { video_frame, audio_samples, input, NULL, NULL, NULL };
+
+/**** video ****/
+static SDL_Window *window;
+static SDL_Renderer *renderer;
+
+static SDL_Texture *background_map;
+static uint8_t background_buffer[256 * 256 * 4];
+
+static SDL_Texture *window_map;
+static uint8_t window_buffer[256 * 256 * 4];
+
+static SDL_Texture *tile_data;
+static uint8_t tile_buffer[16 * 24 * 64 * 4]; // 16 x 24 tiles, each 64 pixels, each pixel 4 bytes
+
+static SDL_Texture *display;
+
+// triple buffered frames: the emulation thread fills the back buffer and swaps it with the middle one, the main
+// loop swaps the middle one with its front buffer when a new frame is flagged - no buffer is ever shared
+#define FRAME_NEW                        0x04      // middle buffer holds a frame not yet presented
+
+static uint8_t frames[3][DISPLAY_WIDTH * DISPLAY_HEIGHT * 4];
+static int back_frame = 0;                 // emulation thread only
+static SDL_atomic_t middle_frame = { 1 };  // buffer index | FRAME_NEW
+static int front_frame = 2;                // main thread only
+
+static SDL_atomic_t input_snapshot;        // buttons sampled by the main thread, read by the emulation thread
+static SDL_GameController *controller;
+
+/**** audio ****/
+static SDL_AudioDeviceID audio_device;
+static int audio_driven;                            // emulation is clocked by the audio callback (otherwise the main loop emulates)
+static volatile uint64_t emulation_ticks;           // performance counter ticks spent emulating inside the audio callback
+
+static AudioFormat audio_format;
+static uint32_t sampling_frequency;
+static uint32_t frame_bytes;                        // bytes per stereo sample in the device format
+static float float_samples[APU_BUFFER_SIZE];        // APU samples converted for AUDIO_FORMAT_F32
+
+static volatile int fast_forward;                   // emulation is run by the main loop faster than real time
+static int fast_forward_mute;                       // fast forward audio is muted (otherwise it is time-stretched)
+
+// fast forward time-stretch: grains of the newest audio are overlap-added at normal speed
+static int16_t stretch_window[STRETCH_GRAIN];       // newest APU samples
+static int stretch_count;                           // samples slid into the window since the last grain
+static int16_t stretch_tail[STRETCH_OVERLAP];       // end of the last grain, faded out under the next one
+
+// single-producer/single-consumer lock-free ring between the emulation thread and the audio callback
+static struct AudioRing
+{
+    uint8_t data[AUDIO_RING_MAX_SIZE];
+    uint32_t size;              // power of two
+    SDL_atomic_t read;          // free-running read index, written by the consumer only
+    SDL_atomic_t write;         // free-running write index, written by the producer only
+} ring;
+
+static uint32_t target_fill;    // ring fill level (bytes) dynamic rate control steers towards - the audio latency
+
+static uint32_t ring_count(void)
+{
+    uint32_t count = (uint32_t)SDL_AtomicGet(&ring.write) - (uint32_t)SDL_AtomicGet(&ring.read);
+    SDL_MemoryBarrierAcquire();
+
+    return count;
+}
+
+// producer: all or nothing, so that fast forward keeps or drops whole sample buffers
+static int ring_push(const uint8_t *data, uint32_t length)
+{
+    uint32_t write = (uint32_t)SDL_AtomicGet(&ring.write);
+
+    if (length > ring.size - ring_count())
+        return 0;
+
+    uint32_t index = write & (ring.size - 1);
+    uint32_t first = length < ring.size - index ? length : ring.size - index;
+
+    memcpy(ring.data + index, data, first);
+    memcpy(ring.data, data + first, length - first);
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring.write, (int)(write + length));
+
+    return 1;
+}
+
+// consumer: returns bytes actually read
+static uint32_t ring_pop(uint8_t *data, uint32_t length)
+{
+    uint32_t read = (uint32_t)SDL_AtomicGet(&ring.read);
+    uint32_t count = ring_count();
+
+    if (length > count)
+        length = count;
+
+    uint32_t index = read & (ring.size - 1);
+    uint32_t first = length < ring.size - index ? length : ring.size - index;
+
+    memcpy(data, ring.data + index, first);
+    memcpy(data + first, ring.data, length - first);
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring.read, (int)(read + length));
+
+    return length;
+}
+
+static void audio_callback(void *userdata, uint8_t *stream, int len)
+{
+    if (audio_driven && !fast_forward)   // emulate until there are enough samples (ring is used from this thread only)
+    {
+        uint64_t start = SDL_GetPerformanceCounter();
+
+        while (ring_count() < (uint32_t)len)
+            gameboy_run_cycles(AUDIO_CHUNK_CYCLES);
+
+        emulation_ticks += SDL_GetPerformanceCounter() - start;
+    }
+
+    uint32_t length = ring_pop(stream, len);
+    memset(stream + length, 0, len - length);   // underrun: silence
+}
+
+int frontend_SDL_init(int vsync, int audio, int latency, uint32_t frequency, AudioFormat format)
+{
+    // initialize graphics system
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0)
+    {
+        printf("error initializing SDL: %s", SDL_GetError());
+        return 0;
+    }
+
+    uint8_t paddingX = 60, paddingY = 20;
+    window = SDL_CreateWindow("GameBoy Emulator", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, paddingX + DISPLAY_WIDTH * 4 + 8 * 8 + 256 * 2, paddingY + DISPLAY_HEIGHT * 4, 0);
+    if (!window)
+    {
+        printf("error creating window: %s", SDL_GetError());
+        return 0;
+    }
+
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | (vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
+    if (!renderer)
+    {
+        printf("error creating renderer: %s", SDL_GetError());
+        return 0;
+    }
+
+    display = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    background_map = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, 256, 256);
+    window_map = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, 256, 256);
+    tile_data = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, 16 * 8, 24 * 8);
+    if (!display || !background_map || !window_map || !tile_data)
+    {
+        printf("error creating texture: %s", SDL_GetError());
+        return 0;
+    }
+
+    // initialize audio system
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+        printf("error initializing audio system: %s", SDL_GetError());
+
+    if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) != 0)
+        printf("error initializing game controller system: %s", SDL_GetError());
+
+    audio_driven = audio;
+    audio_format = format;
+    sampling_frequency = frequency;
+    frame_bytes = format == AUDIO_FORMAT_F32 ? 2 * sizeof(float) : 2 * sizeof(int16_t);
+
+    // ring holds twice the requested latency plus a frame's worth of samples pushed at once by the main loop
+    target_fill = sampling_frequency * latency / 1000 * frame_bytes;
+
+    uint32_t frame_size = sampling_frequency / 59 * frame_bytes;
+    for (ring.size = 0x1000; ring.size < target_fill * 2 + frame_size && ring.size < AUDIO_RING_MAX_SIZE; ring.size <<= 1)
+        ;
+
+    SDL_AtomicSet(&ring.read, 0);
+    SDL_AtomicSet(&ring.write, 0);
+
+    // audio device buffer no larger than half the requested latency
+    uint16_t device_samples = 2048;
+    while (device_samples > 64 && device_samples * frame_bytes > target_fill / 2)
+        device_samples >>= 1;
+
+    SDL_AudioSpec audio_settings = { 0 };
+
+    audio_settings.format = format == AUDIO_FORMAT_F32 ? AUDIO_F32SYS : AUDIO_S16SYS;
+    audio_settings.freq = sampling_frequency;
+    audio_settings.channels = 2;  // stereo
+    audio_settings.samples = device_samples;
+    audio_settings.callback = audio_callback;
+    audio_settings.userdata = NULL;
+
+    if ((audio_device = SDL_OpenAudioDevice(NULL, 0, &audio_settings, NULL, 0)) == 0)
+        printf("error opening audio device: %s", SDL_GetError());
+
+    SDL_PauseAudioDevice(audio_device, 0);
+
+    return 1;
+}
+
+void frontend_SDL_deinit(void)
+{
+    if (controller)
+        SDL_GameControllerClose(controller);
+
+    SDL_CloseAudioDevice(audio_device);
+
+    SDL_DestroyTexture(tile_data);
+    SDL_DestroyTexture(window_map);
+    SDL_DestroyTexture(background_map);
+    SDL_DestroyTexture(display);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+}
+
+static void video_frame(const uint32_t *pixels)
+{
+    memcpy(frames[back_frame], pixels, sizeof frames[0]);
+
+    back_frame = SDL_AtomicSet(&middle_frame, back_frame | FRAME_NEW) & 0x03;   // publish, take the old middle buffer
+}
+
+int frontend_SDL_frame_ready(void)
+{
+    if (!(SDL_AtomicGet(&middle_frame) & FRAME_NEW))
+        return 0;
+
+    front_frame = SDL_AtomicSet(&middle_frame, front_frame) & 0x03;   // takes the newest frame, even one completed after the check
+
+    return 1;
+}
+
+void frontend_SDL_present(void)
+{
+    SDL_LockAudioDevice(audio_device);   // VRAM views are rendered here, with the audio callback (which may emulate) held off
+    PPU_render_VRAM(tile_buffer, background_buffer, window_buffer);
+    SDL_UnlockAudioDevice(audio_device);
+
+    SDL_SetRenderDrawColor(renderer, 0xD0, 0xD0, 0xD0, 0x00);
+    SDL_RenderClear(renderer);
+
+    SDL_UpdateTexture(display, NULL, (const void*)frames[front_frame], DISPLAY_WIDTH * 4);
+    SDL_Rect display_rect = { 10, 10, DISPLAY_WIDTH * 4, DISPLAY_HEIGHT * 4 };
+    SDL_RenderCopy(renderer, display, NULL, &display_rect);
+
+    SDL_UpdateTexture(background_map, NULL, (const void*)background_buffer, 256 * 4);
+    SDL_Rect background_map_rect = { 10 + DISPLAY_WIDTH * 4 + 10, 10, 256 * 1, 256 * 1};
+    SDL_RenderCopy(renderer, background_map, NULL, &background_map_rect);
+
+    SDL_UpdateTexture(window_map, NULL, (const void*)window_buffer, 256 * 4);
+    SDL_Rect window_map_rect = { 10 + DISPLAY_WIDTH * 4 + 10, 10 + 256 * 1.1 + 10, 256 * 1 , 256 * 1};
+    SDL_RenderCopy(renderer, window_map, NULL, &window_map_rect);
+
+    SDL_UpdateTexture(tile_data, NULL, (const void*)tile_buffer, 16 * 8 * 4);
+    SDL_Rect tile_data_rect = { 20 + DISPLAY_WIDTH * 4 + 10 + 256 * 1.1, 10 , 16 * 8 *2, 24 * 8 *2};
+    SDL_RenderCopy(renderer,tile_data, NULL, &tile_data_rect);
+
+    SDL_RenderPresent(renderer);   // blocks until next display refresh with vsync
+}
+
+static void audio_push(const int16_t *samples, int length)
+{
+    if (audio_format == AUDIO_FORMAT_F32)
+    {
+        for (int offset = 0; offset < length; offset += APU_BUFFER_SIZE)
+        {
+            int count = length - offset < APU_BUFFER_SIZE ? length - offset : APU_BUFFER_SIZE;
+            for (int i = 0; i < count; i++)
+                float_samples[i] = samples[offset + i] * (1.0f / 32768.0f);
+
+            ring_push((const uint8_t*)float_samples, count * sizeof(float));
+        }
+    }
+    else
+        ring_push((const uint8_t*)samples, length * sizeof(int16_t));
+}
+
+// overlap-add time-stretch: whenever the ring drains below the target latency the newest grain of audio is played
+// at normal speed, its head crossfaded with the tail of the previous grain - pitch is preserved and the audio skipped
+// in between (the speed-up) leaves no discontinuity (grains are not aligned by correlation, so tones may beat slightly)
+static void stretch_samples(const int16_t *samples, int length)
+{
+    if (length >= STRETCH_GRAIN)
+        memcpy(stretch_window, samples + length - STRETCH_GRAIN, sizeof stretch_window);
+    else
+    {
+        memmove(stretch_window, stretch_window + length, (STRETCH_GRAIN - length) * sizeof(int16_t));
+        memcpy(stretch_window + STRETCH_GRAIN - length, samples, length * sizeof(int16_t));
+    }
+
+    stretch_count += length;
+    if (stretch_count < STRETCH_GRAIN)   // grains never repeat audio
+        return;
+
+    stretch_count = STRETCH_GRAIN;
+    if (ring_count() >= target_fill)
+        return;
+
+    stretch_count = 0;
+
+    int16_t grain[STRETCH_GRAIN - STRETCH_OVERLAP];
+    const int fade = STRETCH_OVERLAP / 2 + 1;   // stereo samples: both channels share the crossfade weight
+    for (int i = 0; i < STRETCH_OVERLAP; i++)
+        grain[i] = (stretch_tail[i] * (fade - 1 - i / 2) + stretch_window[i] * (i / 2 + 1)) / fade;
+
+    memcpy(grain + STRETCH_OVERLAP, stretch_window + STRETCH_OVERLAP, (STRETCH_GRAIN - 2 * STRETCH_OVERLAP) * sizeof(int16_t));
+    memcpy(stretch_tail, stretch_window + STRETCH_GRAIN - STRETCH_OVERLAP, sizeof stretch_tail);
+
+    audio_push(grain, STRETCH_GRAIN - STRETCH_OVERLAP);
+}
+
+static void audio_samples(const int16_t *samples, int length)
+{
+    if (fast_forward)
+    {
+        if (!fast_forward_mute)
+            stretch_samples(samples, length);
+
+        return;
+    }
+
+    // dynamic rate control: nudge the resampling ratio so the ring stays around the target latency
+    // instead of slowly underrunning or overrunning when emulation is locked to video refresh
+    if (!audio_driven)
+    {
+        double fill = (double)ring_count() / (2 * target_fill);
+        double ratio = 1.0 + (1.0 - 2.0 * (fill > 1.0 ? 1.0 : fill)) * MAX_RATE_DELTA;
+
+        APU_set_sampling_frequency(sampling_frequency * ratio);
+    }
+
+    audio_push(samples, length);
+}
+
+uint64_t frontend_SDL_emulation_ticks(void)
+{
+    return emulation_ticks;
+}
+
+void frontend_SDL_set_fast_forward(int enabled, int mute)
+{
+    // wait for audio callback to return: with audio pacing the producer moves between the audio callback and the main loop
+    SDL_LockAudioDevice(audio_device);
+
+    fast_forward = enabled;
+    fast_forward_mute = mute;
+
+    stretch_count = 0;   // the first grain fades in from silence
+    memset(stretch_tail, 0, sizeof stretch_tail);
+
+    SDL_UnlockAudioDevice(audio_device);
+
+    APU_set_sampling_frequency(sampling_frequency);
+}
+
+int frontend_SDL_refresh_rate(void)
+{
+    SDL_DisplayMode mode;
+
+    if (SDL_GetDesktopDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) != 0 || mode.refresh_rate == 0)
+        return 60;
+
+    return mode.refresh_rate;
+}
+
+/**** input ****/
+
+static uint8_t keyboard_buttons(void)
+{
+    const uint8_t *keyboard_state = SDL_GetKeyboardState(NULL);
+
+    uint8_t buttons = 0x00;
+
+    if (keyboard_state[SDL_SCANCODE_RIGHT])
+        buttons |= BUTTON_RIGHT;
+    if (keyboard_state[SDL_SCANCODE_LEFT])
+        buttons |= BUTTON_LEFT;
+    if (keyboard_state[SDL_SCANCODE_UP])
+        buttons |= BUTTON_UP;
+    if (keyboard_state[SDL_SCANCODE_DOWN])
+        buttons |= BUTTON_DOWN;
+
+    if (keyboard_state[SDL_SCANCODE_A])
+        buttons |= BUTTON_A;
+    if (keyboard_state[SDL_SCANCODE_S])
+        buttons |= BUTTON_B;
+    if (keyboard_state[SDL_SCANCODE_Q])
+        buttons |= BUTTON_SELECT;
+    if (keyboard_state[SDL_SCANCODE_W])
+        buttons |= BUTTON_START;
+
+    return buttons;
+}
+
+static uint8_t controller_buttons(void)
+{
+    if (!controller)   // pick up the first game controller plugged in
+        for (int i = 0; i < SDL_NumJoysticks() && !controller; i++)
+            if (SDL_IsGameController(i))
+                controller = SDL_GameControllerOpen(i);
+
+    if (!controller)
+        return 0x00;
+
+    uint8_t buttons = 0x00;
+
+    if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_RIGHT))
+        buttons |= BUTTON_RIGHT;
+    if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_LEFT))
+        buttons |= BUTTON_LEFT;
+    if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_UP))
+        buttons |= BUTTON_UP;
+    if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_DPAD_DOWN))
+        buttons |= BUTTON_DOWN;
+
+    if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_A))
+        buttons |= BUTTON_A;
+    if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_B))
+        buttons |= BUTTON_B;
+    if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_BACK))
+        buttons |= BUTTON_SELECT;
+    if (SDL_GameControllerGetButton(controller, SDL_CONTROLLER_BUTTON_START))
+        buttons |= BUTTON_START;
+
+    return buttons;
+}
+
+// main thread: SDL input state must only be read from the thread pumping events
+void frontend_SDL_poll_input(void)
+{
+    SDL_AtomicSet(&input_snapshot, keyboard_buttons() | controller_buttons());
+}
+
+static uint8_t input(void)
+{
+    return (uint8_t)SDL_AtomicGet(&input_snapshot);
+}
\ No newline at end of file
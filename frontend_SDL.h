@@ -0,0 +1,24 @@
+#ifndef __FRONTEND_SDL_H__
+#define __FRONTEND_SDL_H__
+
+#include <stdint.h>
+#include "frontend.h"
+
+typedef enum AudioFormat { AUDIO_FORMAT_S16, AUDIO_FORMAT_F32 } AudioFormat;
+
+extern const Frontend frontend_SDL;
+
+int frontend_SDL_init(int vsync, int audio_driven, int latency, uint32_t frequency, AudioFormat format);   // latency in ms
+void frontend_SDL_deinit(void);
+
+int frontend_SDL_frame_ready(void);
+void frontend_SDL_present(void);
+
+uint64_t frontend_SDL_emulation_ticks(void);
+
+void frontend_SDL_poll_input(void);   // main thread, once per loop iteration
+
+void frontend_SDL_set_fast_forward(int enabled, int mute);
+int frontend_SDL_refresh_rate(void);
+
+#endif  // __FRONTEND_SDL_H__
\ No newline at end of file
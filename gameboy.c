@@ -0,0 +1,316 @@
+#include "gameboy.h"
+#include "CPU.h"
+#include "bus.h"
+#include "PPU.h"
+#include "APU.h"
+#include "DMA.h"
+#include "timer.h"
+#include "serial.h"
+#include "link.h"
+#include "joypad.h"
+#include "cartridge.h"
+#include "state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define STATE_MAGIC             0x54534247   // "GBST"
+#define STATE_VERSION                    2   // bump when a module's state layout changes
+
+#define BOOT_CYCLE_LIMIT     (10 * CLOCK_FREQUENCY)   // the boot ROM hands over within a few seconds or locks up for good
+
+Frontend frontend;
+
+uint64_t clock_cycles;
+
+static BootMode boot_mode = BOOT_MODE_ROM;
+static const char *boot_cache;   // directory of post-boot snapshots, NULL: no cache
+
+typedef struct StateHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ROM_hash;
+    uint64_t size;
+} StateHeader;
+
+static void post_boot_state(void);
+static int boot_cached(void);
+
+int gameboy_init(const Frontend *callbacks, uint32_t sampling_frequency)
+{
+    frontend = *callbacks;
+    clock_cycles = 0;
+    cartridge_clock_reset();
+
+    /**** initialize emulator's systems ****/
+    if (!CPU_init(boot_mode != BOOT_MODE_FAST))
+        return 0;
+
+    PPU_init();
+    APU_init(sampling_frequency);
+    timer_init();
+    serial_init();
+    joypad_init();
+
+    if (boot_mode == BOOT_MODE_FAST)
+        post_boot_state();
+    else if (boot_cache && !boot_cached())
+        return 0;
+
+    return 1;
+}
+
+void gameboy_set_boot_mode(BootMode mode, const char *cache_directory)
+{
+    boot_mode = mode;
+    boot_cache = cache_directory;
+}
+
+void gameboy_deinit(void)
+{
+    link_disconnect();
+    APU_deinit();
+    PPU_deinit();
+}
+
+void gameboy_clock(void)
+{
+    if (DMA_active)
+        DMA_copy();
+
+    CPU_execute_machine_cycle();
+
+    clock_cycles += 4;
+
+    if (clock_cycles >= timer_next_event)   // timer is computed lazily, only its events are clocked
+        timer_clock();
+
+    if (clock_cycles >= serial_next_event)   // serial transfer end or link cable sync point
+        serial_clock();
+
+    PPU_clock();
+    PPU_clock();
+    PPU_clock();
+    PPU_clock();
+
+    APU_clock(4);
+}
+
+void gameboy_run_cycles(uint32_t cycles)
+{
+    uint64_t end = clock_cycles + cycles;
+
+    while (clock_cycles < end)
+    {
+        if (clock_cycles >= joypad_next_latch)
+            joypad_latch();
+
+        uint64_t stop = end < joypad_next_latch ? end : joypad_next_latch;   // run up to the next input sample
+
+        while (clock_cycles < stop)
+            gameboy_clock();  // @ 1.048576 MHz
+    }
+
+    APU_end_frame();   // synthesize audio for the emulated cycles
+
+    if (clock_cycles >= cartridge_next_flush)
+        cartridge_flush(0);   // periodic write back of battery backed RAM, never waits for the disk
+}
+
+void gameboy_run_frame(void)
+{
+    gameboy_run_cycles(FRAME_CYCLES);
+}
+
+/**** machine state snapshot ****/
+static void gameboy_state(State *state)
+{
+    state_io(state, &clock_cycles, sizeof clock_cycles);   // first: modules reschedule their events on load
+
+    CPU_state(state);
+    bus_state(state);
+    PPU_state(state);
+    APU_state(state);
+    timer_state(state);
+    serial_state(state);
+    DMA_state(state);
+    joypad_state(state);
+    cartridge_state(state);
+}
+
+size_t gameboy_state_size(void)
+{
+    State state = { NULL, 0, 0 };
+    gameboy_state(&state);
+
+    return state.size;
+}
+
+void gameboy_save_state(uint8_t *snapshot)
+{
+    State state = { snapshot, 0, 0 };
+    gameboy_state(&state);
+}
+
+void gameboy_load_state(const uint8_t *snapshot)
+{
+    State state = { (uint8_t*)snapshot, 0, 1 };
+    gameboy_state(&state);
+}
+
+/**** fast boot ****/
+static void post_boot_state(void)
+{
+    // CPU registers and the divider already hold their post-boot values, set the I/O registers the boot ROM leaves behind
+    static const uint16_t IO_address[] = { 0xFF26, 0xFF11, 0xFF12, 0xFF25, 0xFF24, 0xFF47, 0xFF40, 0xFF13, 0xFF14, 0xFF0F };
+    static const uint8_t IO_data[] =     {   0x80,   0x80,   0xF3,   0xF3,   0x77,   0xFC,   0x91,   0xC1,   0x87,   0xE1 };
+
+    for (int i = 0; i < sizeof IO_data; i++)
+        bus_write(IO_address[i], IO_data[i]);
+
+    // logo tiles: each nibble of the cartridge header logo is doubled to a byte and written to two consecutive rows
+    uint16_t HL = 0x8010;
+    for (uint16_t address = 0x0104; address < 0x0134; address++)
+    {
+        uint8_t logo = bus_read(address);
+
+        for (int shift = 4; shift >= 0; shift -= 4, HL += 4)
+        {
+            uint8_t nibble = logo >> shift & 0x0F;
+            uint8_t row = 0;
+
+            for (int bit = 0; bit < 4; bit++)
+                if (nibble & 1 << bit)
+                    row |= 3 << 2 * bit;
+
+            bus_write(HL, row);
+            bus_write(HL + 2, row);
+        }
+    }
+
+    // registered trademark tile
+    static const uint8_t trademark[] = { 0x3C, 0x42, 0xB9, 0xA5, 0xB9, 0xA5, 0x42, 0x3C };
+    for (int i = 0; i < sizeof trademark; i++)
+        bus_write(0x8190 + 2 * i, trademark[i]);
+
+    // logo tile map: two rows of 12 tiles plus the trademark
+    bus_write(0x9910, 0x19);
+    for (uint8_t tile = 0x18, column = 0; tile > 0; tile--, column++)
+        bus_write((tile > 0x0C ? 0x992F : 0x990F) - column % 12, tile);
+
+    bus_write(0xFF50, 0x01);   // unmap bootstrap ROM
+}
+
+// run the bootstrap ROM to completion with the front end detached (no logo frames, sound or input)
+int gameboy_boot(void)
+{
+    Frontend callbacks = frontend;
+    memset(&frontend, 0, sizeof frontend);
+
+    uint64_t limit = clock_cycles + BOOT_CYCLE_LIMIT;
+    while (cpu.boot && clock_cycles < limit)
+    {
+        if (clock_cycles >= joypad_next_latch)
+            joypad_latch();
+
+        gameboy_clock();
+
+        if (!(clock_cycles & 0x3FFF))
+            APU_end_frame();   // keep the synthesis buffers from filling up
+    }
+    APU_end_frame();
+
+    frontend = callbacks;
+
+    if (cpu.boot)   // the boot ROM halts on a bad logo or header checksum
+    {
+        printf("error: boot ROM did not reach the cartridge, bad logo or header checksum\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+/**** post-boot snapshot cache ****/
+static int load_boot_snapshot(const char *path, uint64_t hash, size_t size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    StateHeader header;
+    uint8_t *snapshot = (uint8_t*)malloc(size);
+    int valid = snapshot && fread(&header, sizeof header, 1, file) == 1 &&
+                header.magic == STATE_MAGIC && header.version == STATE_VERSION &&
+                header.ROM_hash == hash && header.size == size &&
+                fread(snapshot, 1, size, file) == size;
+    fclose(file);
+
+    if (valid)
+    {
+        State state = { snapshot, 0, 1, 1 };
+        gameboy_state(&state);
+    }
+    free(snapshot);
+
+    return valid;
+}
+
+static void save_boot_snapshot(const char *path, uint64_t hash, size_t size)
+{
+    char temp_path[PATH_MAX];
+    int length = snprintf(temp_path, sizeof temp_path, "%s.%d", path, (int)getpid());   // renamed when complete, parallel runs never see a partial file
+    if (length < 0 || length >= (int)sizeof temp_path)
+        return;
+
+    uint8_t *snapshot = (uint8_t*)malloc(size);
+    FILE *file = snapshot ? fopen(temp_path, "wb") : NULL;
+    if (!file)
+    {
+        printf("error creating boot snapshot %s\n", temp_path);
+        free(snapshot);
+        return;
+    }
+
+    StateHeader header = { STATE_MAGIC, STATE_VERSION, hash, size };
+    State state = { snapshot, 0, 0, 1 };
+    gameboy_state(&state);
+
+    int written = fwrite(&header, sizeof header, 1, file) == 1 && fwrite(snapshot, 1, size, file) == size;
+    free(snapshot);
+    if (fclose(file) == 0 && written)
+        rename(temp_path, path);
+    else
+        unlink(temp_path);
+}
+
+static int boot_cached(void)
+{
+    uint64_t hash = cartridge_hash();
+    State state = { NULL, 0, 0, 1 };   // size of a boot snapshot
+    gameboy_state(&state);
+    size_t size = state.size;
+
+    char path[PATH_MAX];
+    int length = snprintf(path, sizeof path, "%s/%016llx.state", boot_cache, (unsigned long long)hash);
+    if (length < 0 || length >= (int)sizeof path)   // cache directory path too long: boot without the cache
+    {
+        printf("error: boot cache path too long: %s\n", boot_cache);
+        return gameboy_boot();
+    }
+
+    if (load_boot_snapshot(path, hash, size))
+        return 1;
+
+    if (!gameboy_boot())   // first run of this ROM: boot it, then snapshot the machine
+        return 0;
+
+    mkdir(boot_cache, 0755);
+    save_boot_snapshot(path, hash, size);
+
+    return 1;
+}
\ No newline at end of file
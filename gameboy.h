@@ -0,0 +1,34 @@
+#ifndef __GAMEBOY_H__
+#define __GAMEBOY_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "frontend.h"
+
+#define CLOCK_FREQUENCY           4194304
+#define FRAME_CYCLES                70224     // clock cycles per frame (154 scanlines x 456 clocks) - ~59.73 Hz
+
+extern uint64_t clock_cycles;   // clock cycles since power on
+
+typedef enum BootMode
+{
+    BOOT_MODE_ROM,    // run the bootstrap ROM
+    BOOT_MODE_FAST    // start at 0x100 in the post-boot state, no boot ROM file needed
+} BootMode;
+
+void gameboy_set_boot_mode(BootMode mode, const char *cache_directory);   // before init - ROM mode with a cache directory boots each ROM once and reuses its post-boot snapshot
+
+int gameboy_init(const Frontend *callbacks, uint32_t sampling_frequency);   // cartridge must be loaded first - sampling frequency 0 disables audio
+void gameboy_deinit(void);
+
+int gameboy_boot(void);   // run the bootstrap ROM silently up to 0x100 (no-op after fast or cached boot) - 0: it locked up
+
+void gameboy_clock(void);
+void gameboy_run_cycles(uint32_t cycles);   // audio for the emulated cycles is handed to the front end at the end
+void gameboy_run_frame(void);
+
+size_t gameboy_state_size(void);
+void gameboy_save_state(uint8_t *snapshot);         // snapshot of gameboy_state_size() bytes
+void gameboy_load_state(const uint8_t *snapshot);
+
+#endif  // __GAMEBOY_H__
\ No newline at end of file
@@ -0,0 +1,592 @@
+#include "gameboy.h"
+#include "cartridge.h"
+#include "CPU.h"
+#include "instruction_set.h"
+#include "bus.h"
+#include "PPU.h"
+#include "APU.h"
+#include "DMA.h"
+#include "timer.h"
+#include "perf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// microbenchmarks of the emulation core hot paths plus whole frame throughput - each benchmark is repeated
+// with a growing iteration count until it runs for at least --time seconds, results go to a JSON file so runs
+// before and after a change can be compared by a script. Hardware counters (perf.h) are read around every
+// benchmark when the kernel provides them, so a regression can be told apart as more instructions, branch
+// mispredictions or cache misses
+
+#define DEFAULT_OUTPUT          "bench.json"
+#define DEFAULT_TIME                   0.05    // seconds per microbenchmark (~500 of them)
+#define DEFAULT_FRAMES                  600
+#define WARMUP_FRAMES                    60
+#define MAX_RESULTS                    1024
+
+#define BENCH_CODE                   0xC000    // instruction under test and its operands, in work RAM
+#define BENCH_HL                     0xC100    // register pointers: scratch work RAM past the code
+#define BENCH_BC                     0xC280    // C is BENCH_OPERAND1 as well: (C) is 0xFF80 (HRAM)
+#define BENCH_DE                     0xC300
+#define BENCH_SP                     0xDFF0
+#define BENCH_OPERAND1                 0x80    // u8: 0xFF80 (HRAM) - i8: -128
+#define BENCH_OPERAND2                 0xC2    // u16: 0xC280 (work RAM)
+
+static const char *default_ROMs[] =
+{
+    "Test ROMs/cpu_instrs/cpu_instrs",
+    "Test ROMs/instr_timing/instr_timing",
+};
+
+typedef struct Result
+{
+    char name[64];
+    double ns_per_op;
+    uint64_t ops;
+    PerfCounters counters;
+} Result;
+
+typedef struct FrameResult
+{
+    const char *rom_name;
+    double frames_per_second;
+    double ns_per_frame;
+    uint32_t frames;
+    PerfCounters counters;
+} FrameResult;
+
+static Result results[MAX_RESULTS];
+static int result_count;
+
+static double min_time = DEFAULT_TIME;
+static volatile uint8_t sink;   // keeps benchmarked reads from being optimized away
+
+static Frontend frontend_bench = { NULL, NULL, NULL, NULL, NULL, NULL };
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void print_counters(const PerfCounters *counters, uint64_t ops, const char *unit)
+{
+    if (perf_available(PERF_CYCLES) && perf_available(PERF_INSTRUCTIONS) && counters->value[PERF_CYCLES])
+        printf("  %5.2f IPC", (double)counters->value[PERF_INSTRUCTIONS] / counters->value[PERF_CYCLES]);
+
+    if (perf_available(PERF_BRANCH_MISSES))
+        printf("  %8.3f branch misses/%s", (double)counters->value[PERF_BRANCH_MISSES] / ops, unit);
+
+    if (perf_available(PERF_L1D_MISSES))
+        printf("  %8.3f L1D misses/%s", (double)counters->value[PERF_L1D_MISSES] / ops, unit);
+
+    if (perf_available(PERF_LLC_MISSES))
+        printf("  %8.3f LLC misses/%s", (double)counters->value[PERF_LLC_MISSES] / ops, unit);
+
+    printf("\n");
+}
+
+static void add_result(const char *name, double elapsed, uint64_t ops, const PerfCounters *counters)
+{
+    if (result_count == MAX_RESULTS)
+        return;
+
+    Result *result = &results[result_count++];
+    snprintf(result->name, sizeof result->name, "%s", name);
+    result->ns_per_op = elapsed * 1e9 / ops;
+    result->ops = ops;
+    result->counters = *counters;
+
+    printf("%-40s %10.2f ns/op", name, result->ns_per_op);
+    print_counters(counters, ops, "op");
+}
+
+// run benchmark with 1, 10, 100... iterations until it takes min_time, then scale up once more to min_time
+static void measure(const char *name, void (*benchmark)(uint32_t iterations))
+{
+    uint32_t iterations = 1;
+
+    for (;;)
+    {
+        PerfCounters counters, start_counters;
+
+        perf_read(&start_counters);
+        double start = seconds();
+        benchmark(iterations);
+        double elapsed = seconds() - start;
+        perf_read(&counters);
+        perf_elapsed(&counters, &start_counters);
+
+        if (elapsed >= min_time || iterations >= UINT32_MAX / 10)
+        {
+            add_result(name, elapsed, iterations, &counters);
+            return;
+        }
+
+        iterations = elapsed > min_time / 100 ? (uint32_t)(iterations * min_time * 1.2 / elapsed) : iterations * 10;
+    }
+}
+
+/**** bus ****/
+typedef struct BusRegion
+{
+    const char *name;
+    uint16_t address;
+    uint16_t span;   // bytes accessed from address, power of two
+} BusRegion;
+
+static const BusRegion read_regions[] =
+{
+    { "ROM bank 0",        0x0100, 16 },
+    { "ROM bank N",        0x4000, 16 },
+    { "VRAM",              0x8000, 16 },
+    { "external RAM",      0xA000, 16 },
+    { "work RAM",          0xC000, 16 },
+    { "echo RAM",          0xE000, 16 },
+    { "OAM",               0xFE00, 16 },
+    { "IO (SCY)",          0xFF42,  1 },
+    { "HRAM",              0xFF80, 16 },
+    { "IE",                0xFFFF,  1 },
+};
+
+static const BusRegion write_regions[] =
+{
+    { "MBC RAM enable",    0x0000,  1 },
+    { "MBC ROM bank",      0x2000,  1 },
+    { "VRAM",              0x8000, 16 },
+    { "external RAM",      0xA000, 16 },
+    { "work RAM",          0xC000, 16 },
+    { "echo RAM",          0xE000, 16 },
+    { "OAM",               0xFE00, 16 },
+    { "IO (SCY)",          0xFF42,  1 },
+    { "HRAM",              0xFF80, 16 },
+    { "IE",                0xFFFF,  1 },
+};
+
+static uint16_t bench_address;
+static uint16_t bench_mask;   // span - 1
+
+static void bench_bus_read(uint32_t iterations)
+{
+    uint16_t address = bench_address;
+    uint16_t mask = bench_mask;
+    uint8_t data = 0;
+
+    while (iterations--)
+        data += bus_read(address + (iterations & mask));   // stays inside the region
+
+    sink = data;
+}
+
+static void bench_bus_write(uint32_t iterations)
+{
+    uint16_t address = bench_address;
+    uint16_t mask = bench_mask;
+
+    while (iterations--)
+        bus_write(address + (iterations & mask), iterations);
+}
+
+static void bench_bus(void)
+{
+    char name[64];
+
+    for (size_t i = 0; i < sizeof read_regions / sizeof read_regions[0]; i++)
+    {
+        bench_address = read_regions[i].address;
+        bench_mask = read_regions[i].span - 1;
+        snprintf(name, sizeof name, "bus_read/%s", read_regions[i].name);
+        measure(name, bench_bus_read);
+    }
+
+    for (size_t i = 0; i < sizeof write_regions / sizeof write_regions[0]; i++)
+    {
+        bench_address = write_regions[i].address;
+        bench_mask = write_regions[i].span - 1;
+        snprintf(name, sizeof name, "bus_write/%s", write_regions[i].name);
+        measure(name, bench_bus_write);
+    }
+
+    bus_write(0x2000, 0x01);   // back to the power on mapping
+    bus_write(0x0000, 0x00);
+}
+
+/**** instruction handlers ****/
+static Instruction *bench_instruction;
+static uint8_t bench_opcode;
+static uint16_t bench_PC;
+
+// all machine cycles of one instruction, as CPU_execute_machine_cycle runs them after the opcode fetch
+static void bench_instruction_handler(uint32_t iterations)
+{
+    Instruction *instruction = bench_instruction;
+    uint8_t machine_cycles = instruction->machine_cycles;   // conditional instructions shorten it while running
+
+    while (iterations--)
+    {
+        cpu.PC = bench_PC;   // every register the instruction may use is reset: stores only ever hit scratch RAM
+        cpu.SP = BENCH_SP;
+        cpu.A = 0x00;
+        cpu.B = BENCH_BC >> 8;
+        cpu.C = BENCH_BC & 0xFF;
+        cpu.D = BENCH_DE >> 8;
+        cpu.E = BENCH_DE & 0xFF;
+        cpu.H = BENCH_HL >> 8;
+        cpu.L = BENCH_HL & 0xFF;
+        cpu.F.reg = 0x00;
+        cpu.W = 0x00;
+        cpu.Z = 0x00;
+        cpu.instruction_register = bench_opcode;
+        cpu.current_instruction = instruction;
+        instruction->machine_cycles = machine_cycles;
+
+        for (cpu.current_machine_cycle = 1; cpu.current_machine_cycle <= instruction->machine_cycles; cpu.current_machine_cycle++)
+            instruction->instruction_handler(&cpu);
+    }
+
+    instruction->machine_cycles = machine_cycles;
+}
+
+static void bench_instructions(void)
+{
+    CPU saved = cpu;
+    char name[64];
+
+    bus_write(BENCH_CODE + 1, BENCH_OPERAND1);
+    bus_write(BENCH_CODE + 2, BENCH_OPERAND2);
+
+    for (int extended = 0; extended < 2; extended++)
+        for (int opcode = 0; opcode < 0x100; opcode++)
+        {
+            Instruction *instruction = extended ? &extended_instruction_table[opcode] : &instruction_table[opcode];
+
+            if (!instruction->instruction_handler || (!extended && (opcode == 0x10 || opcode == 0x76)))   // invalid, prefix, STOP, HALT
+                continue;
+
+            bench_instruction = instruction;
+            bench_opcode = opcode;
+            bench_PC = BENCH_CODE + 1 + extended;   // operands follow the opcode (and the 0xCB prefix)
+
+            snprintf(name, sizeof name, "%s/%02X %s", extended ? "extended_instruction" : "instruction", opcode, instruction->name);
+            measure(name, bench_instruction_handler);
+        }
+
+    cpu = saved;
+    cpu.IME = 0;   // EI, RETI...
+    cpu.EI = 0;
+}
+
+/**** PPU ****/
+// PPU_clock per mode: dots are timed in runs of the same STAT mode (a few runs per scanline)
+static void bench_PPU(void)
+{
+    static const char *mode_names[] = { "PPU_clock/mode 0 HBLANK", "PPU_clock/mode 1 VBLANK", "PPU_clock/mode 2 OAM search", "PPU_clock/mode 3 pixel transfer" };
+    double mode_time[4] = { 0 };
+    uint64_t mode_dots[4] = { 0 };
+    PerfCounters mode_counters[4] = { 0 };
+    double start = seconds();
+
+    while (seconds() - start < min_time * 4)
+        for (int line = 0; line < 154; line++)
+        {
+            int dots = 456;
+
+            while (dots)
+            {
+                uint8_t mode = PPU_read_STAT() & 0x03;
+                PerfCounters counters, start_counters;
+                uint32_t run = 0;
+
+                perf_read(&start_counters);
+                double run_start = seconds();
+
+                do
+                {
+                    PPU_clock();
+                    run++;
+                }
+                while (--dots && (PPU_read_STAT() & 0x03) == mode);
+
+                mode_time[mode] += seconds() - run_start;
+                mode_dots[mode] += run;
+
+                perf_read(&counters);
+                perf_elapsed(&counters, &start_counters);
+                for (int i = 0; i < PERF_COUNTERS; i++)
+                    mode_counters[mode].value[i] += counters.value[i];
+            }
+        }
+
+    for (int mode = 0; mode < 4; mode++)
+        if (mode_dots[mode])
+            add_result(mode_names[mode], mode_time[mode], mode_dots[mode], &mode_counters[mode]);
+}
+
+/**** APU, timer, DMA ****/
+static void bench_APU_clock(uint32_t iterations)
+{
+    for (uint32_t i = 1; i <= iterations; i++)
+    {
+        APU_clock(4);
+
+        if (i % (FRAME_CYCLES / 4) == 0)
+            APU_end_frame();   // frame synthesis is part of the cost
+    }
+
+    APU_end_frame();
+}
+
+static void bench_timer_clock(uint32_t iterations)
+{
+    while (iterations--)
+    {
+        clock_cycles = timer_next_event;   // every call handles an event
+        timer_clock();
+    }
+}
+
+static void bench_DMA_copy(uint32_t iterations)
+{
+    while (iterations--)
+    {
+        if (!DMA_active)
+            DMA_start(BENCH_CODE >> 8);
+
+        DMA_copy();
+    }
+}
+
+static void bench_DMA_start(uint32_t iterations)
+{
+    while (iterations--)
+        DMA_start(BENCH_CODE >> 8);
+
+    DMA_bus_locked = 0;
+}
+
+static void bench_subsystems(void)
+{
+    // sound on all pulse and noise channels so synthesis has work to do
+    bus_write(0xFF17, 0xF0);
+    bus_write(0xFF19, 0x87);
+    bus_write(0xFF21, 0xF0);
+    bus_write(0xFF23, 0x80);
+    measure("APU_clock", bench_APU_clock);
+
+    bus_write(0xFF07, 0x05);   // timer on, fastest rate: an overflow every 1024 clocks
+    measure("timer_clock", bench_timer_clock);
+    bus_write(0xFF07, 0x00);
+
+    DMA_set_mode(DMA_MODE_EXACT);
+    measure("DMA_copy", bench_DMA_copy);
+    while (DMA_active)
+        DMA_copy();
+
+    DMA_set_mode(DMA_MODE_FAST);
+    measure("DMA_start/fast", bench_DMA_start);
+    DMA_set_mode(DMA_MODE_EXACT);   // back to the default for the frame benchmarks
+}
+
+/**** whole frames ****/
+static int start_ROM(const char *rom_name)
+{
+    if (!cartridge_load(rom_name, NULL))
+        return 0;
+
+    if (!gameboy_init(&frontend_bench, SAMPLING_FREQUENCY))
+    {
+        cartridge_unload();
+        return 0;
+    }
+
+    return 1;
+}
+
+static void stop_ROM(void)
+{
+    gameboy_deinit();
+    cartridge_unload();
+}
+
+static int bench_frames(const char *rom_name, uint32_t frames, FrameResult *result)
+{
+    if (!start_ROM(rom_name))
+        return 0;
+
+    for (int i = 0; i < WARMUP_FRAMES; i++)
+        gameboy_run_frame();
+
+    PerfCounters start_counters;
+
+    perf_read(&start_counters);
+    double start = seconds();
+    for (uint32_t i = 0; i < frames; i++)
+        gameboy_run_frame();
+    double elapsed = seconds() - start;
+    perf_read(&result->counters);
+    perf_elapsed(&result->counters, &start_counters);
+
+    stop_ROM();
+
+    result->rom_name = rom_name;
+    result->frames = frames;
+    result->frames_per_second = frames / elapsed;
+    result->ns_per_frame = elapsed * 1e9 / frames;
+
+    printf("%-40s %10.1f fps (%.2fx real time)", rom_name, result->frames_per_second, result->frames_per_second * FRAME_CYCLES / CLOCK_FREQUENCY);
+    print_counters(&result->counters, frames, "frame");
+
+    return 1;
+}
+
+/**** JSON report ****/
+static void write_string(FILE *file, const char *string)
+{
+    fputc('"', file);
+
+    for (; *string; string++)
+        if (*string == '"' || *string == '\\')
+            fprintf(file, "\\%c", *string);
+        else if ((uint8_t)*string < 0x20)
+            fprintf(file, "\\u%04x", *string);
+        else
+            fputc(*string, file);
+
+    fputc('"', file);
+}
+
+// counters divided by ops (per op or per frame), unavailable ones are left out
+static void write_counters(FILE *file, const PerfCounters *counters, uint64_t ops, const char *unit)
+{
+    if (perf_available(PERF_CYCLES) && perf_available(PERF_INSTRUCTIONS) && counters->value[PERF_CYCLES])
+        fprintf(file, ", \"ipc\": %.3f", (double)counters->value[PERF_INSTRUCTIONS] / counters->value[PERF_CYCLES]);
+
+    for (int i = 0; i < PERF_COUNTERS; i++)
+        if (perf_available(i))
+            fprintf(file, ", \"%s_per_%s\": %.3f", perf_name(i), unit, (double)counters->value[i] / ops);
+}
+
+static int write_report(const char *output_name, const char *rom_name, const FrameResult *frame_results, int frame_count)
+{
+    FILE *file = fopen(output_name, "w");
+    if (!file)
+    {
+        printf("error creating %s\n", output_name);
+        return 0;
+    }
+
+    fprintf(file, "{\n  \"rom\": ");
+    write_string(file, rom_name);
+    fprintf(file, ",\n  \"min_time\": %g,\n  \"counters\": [", min_time);
+
+    for (int i = 0, first = 1; i < PERF_COUNTERS; i++)
+        if (perf_available(i))
+        {
+            fprintf(file, first ? " " : ", ");
+            write_string(file, perf_name(i));
+            first = 0;
+        }
+
+    fprintf(file, " ],\n  \"benchmarks\": [\n");
+
+    for (int i = 0; i < result_count; i++)
+    {
+        fprintf(file, "    { \"name\": ");
+        write_string(file, results[i].name);
+        fprintf(file, ", \"ns_per_op\": %.3f, \"ops\": %llu", results[i].ns_per_op, (unsigned long long)results[i].ops);
+        write_counters(file, &results[i].counters, results[i].ops, "op");
+        fprintf(file, " }%s\n", i < result_count - 1 ? "," : "");
+    }
+
+    fprintf(file, "  ],\n  \"frames\": [\n");
+
+    for (int i = 0; i < frame_count; i++)
+    {
+        fprintf(file, "    { \"rom\": ");
+        write_string(file, frame_results[i].rom_name);
+        fprintf(file, ", \"frames\": %u, \"frames_per_second\": %.2f, \"ns_per_frame\": %.0f",
+                frame_results[i].frames, frame_results[i].frames_per_second, frame_results[i].ns_per_frame);
+        write_counters(file, &frame_results[i].counters, frame_results[i].frames, "frame");
+        fprintf(file, " }%s\n", i < frame_count - 1 ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+
+    return fclose(file) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *output_name = DEFAULT_OUTPUT;
+    uint32_t frames = DEFAULT_FRAMES;
+    int micro = 1;   // microbenchmarks, otherwise whole frames only
+    int counters = 1;
+
+    const char **rom_names = (const char**)malloc(sizeof(char*) * argc);
+    int rom_count = 0;
+
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output_name = argv[++i];
+        else if (strncmp(argv[i], "--time=", 7) == 0)
+            min_time = strtod(argv[i] + 7, NULL);
+        else if (strncmp(argv[i], "--frames=", 9) == 0)
+            frames = strtoul(argv[i] + 9, NULL, 10);
+        else if (strcmp(argv[i], "--frames-only") == 0)
+            micro = 0;
+        else if (strcmp(argv[i], "--no-perf") == 0)
+            counters = 0;
+        else if (argv[i][0] != '-')
+            rom_names[rom_count++] = argv[i];
+        else
+            printf("unknown option: %s\n", argv[i]);
+
+    if (!rom_count)
+    {
+        free(rom_names);
+        rom_names = default_ROMs;
+        rom_count = sizeof default_ROMs / sizeof default_ROMs[0];
+    }
+
+    if (min_time <= 0 || !frames)
+    {
+        printf("usage: %s [ROM names] [-o file] [--time=seconds] [--frames=N] [--frames-only] [--no-perf]\n", argv[0]);
+        return -1;
+    }
+
+    gameboy_set_boot_mode(BOOT_MODE_FAST, NULL);   // no boot ROM needed, every run starts from the same state
+
+    if (counters && !perf_open())
+        printf("hardware performance counters unavailable, timing only\n");
+
+    /**** microbenchmarks on the first ROM ****/
+    if (micro)
+    {
+        if (!start_ROM(rom_names[0]))
+            return -1;
+
+        bench_bus();
+        bench_instructions();
+        bench_PPU();
+        bench_subsystems();
+
+        stop_ROM();
+    }
+
+    /**** emulated frames per second ****/
+    FrameResult *frame_results = (FrameResult*)calloc(rom_count, sizeof(FrameResult));
+    int frame_count = 0;
+
+    for (int i = 0; i < rom_count; i++)
+        if (bench_frames(rom_names[i], frames, &frame_results[frame_count]))
+            frame_count++;
+
+    int written = write_report(output_name, rom_names[0], frame_results, frame_count);
+    free(frame_results);
+    perf_close();
+
+    return written && frame_count == rom_count ? 0 : -1;
+}
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "rom_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// ROM library indexer: scans directories of .gb files with -j worker processes and writes a binary index
+// (rom_index.h) that launchers open to find a game by hash or title
+
+#define DEFAULT_INDEX         "ROMs/index.gbx"
+
+static const char **paths;
+static uint32_t path_count, path_capacity;
+
+static void add_path(const char *path)
+{
+    if (path_count == path_capacity)
+    {
+        path_capacity = path_capacity ? path_capacity * 2 : 256;
+        paths = (const char**)realloc(paths, path_capacity * sizeof *paths);
+    }
+
+    paths[path_count++] = strdup(path);
+}
+
+static void find_ROMs(const char *path)
+{
+    struct stat path_stat;
+
+    if (stat(path, &path_stat) == -1)
+    {
+        printf("error reading %s\n", path);
+        return;
+    }
+
+    if (!S_ISDIR(path_stat.st_mode))
+    {
+        add_path(path);   // files named on the command line are indexed whatever their extension
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir)
+    {
+        printf("error reading directory %s\n", path);
+        return;
+    }
+
+    for (struct dirent *entry; (entry = readdir(dir)); )
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        char child[4096];
+        snprintf(child, sizeof child, "%s/%s", path, entry->d_name);
+
+        const char *extension = strrchr(entry->d_name, '.');
+
+        if (entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && stat(child, &path_stat) == 0 && S_ISDIR(path_stat.st_mode)))
+            find_ROMs(child);
+        else if (extension && strcasecmp(extension, ".gb") == 0)
+            add_path(child);
+    }
+
+    closedir(dir);
+}
+
+// worker processes scan every jobs-th ROM and send the entries through one pipe (each write is atomic)
+static RomIndexEntry *scan(long jobs, uint32_t *count)
+{
+    RomIndexEntry *entries = (RomIndexEntry*)malloc(path_count * sizeof *entries + 1);
+    int fds[2];
+
+    if (pipe(fds) < 0)
+    {
+        printf("error starting workers\n");
+        free(entries);
+        return NULL;
+    }
+
+    fflush(stdout);
+
+    int failed = 0;
+    for (long worker = 0; worker < jobs; worker++)
+    {
+        pid_t pid = fork();
+
+        if (pid < 0)
+        {
+            printf("error starting workers\n");
+            failed = 1;
+            break;   // the workers already started still have to be reaped
+        }
+
+        if (pid == 0)
+        {
+            close(fds[0]);
+
+            for (uint32_t i = worker; i < path_count; i += jobs)
+            {
+                RomIndexEntry entry;
+
+                if (rom_index_scan_file(paths[i], &entry))
+                {
+                    entry.path = i;
+                    if (write(fds[1], &entry, sizeof entry) != sizeof entry)
+                    {
+                        printf("error sending entry: %s\n", paths[i]);
+                        fflush(stdout);
+                        _exit(1);
+                    }
+                }
+            }
+
+            fflush(stdout);
+            _exit(0);
+        }
+    }
+
+    close(fds[1]);
+
+    *count = 0;
+    if (!failed)
+        for (ssize_t result; (result = read(fds[0], &entries[*count], sizeof *entries)) == sizeof *entries; )
+            ++*count;
+
+    close(fds[0]);   // after a failed start the remaining workers stop on the closed pipe
+
+    for (int status; wait(&status) > 0; )
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+
+    if (failed)
+    {
+        printf("error scanning ROMs\n");
+        free(entries);
+        return NULL;
+    }
+
+    return entries;
+}
+
+static void print_entry(const RomIndex *index, const RomIndexEntry *entry)
+{
+    printf("%016llx  %-16.16s  type %02X  ROM %02X  RAM %02X  %s %s  %s\n", (unsigned long long)entry->hash, entry->title,
+           entry->type, entry->ROM_size, entry->RAM_size,
+           entry->flags & ROM_INDEX_HEADER_OK ? "header ok " : "header BAD",
+           entry->flags & ROM_INDEX_GLOBAL_OK ? "global ok " : "global BAD", rom_index_path(index, entry));
+}
+
+static int usage(const char *program)
+{
+    printf("usage: %s [-j N] [-o index] <directory | ROM file>...\n"
+           "       %s [-o index] --list | --find=<hash | title>\n", program, program);
+
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *index_name = DEFAULT_INDEX;
+    const char *find_key = NULL;
+    int list = 0;
+
+    for (int i = 1; i < argc; i++)
+        if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            if (!argv[i][2] && i + 1 == argc)   // -j without a count
+                return usage(argv[0]);
+            jobs = strtol(argv[i][2] ? argv[i] + 2 : argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            index_name = argv[++i];
+        else if (strcmp(argv[i], "--list") == 0)
+            list = 1;
+        else if (strncmp(argv[i], "--find=", 7) == 0)
+            find_key = argv[i] + 7;
+        else if (argv[i][0] != '-')
+            find_ROMs(argv[i]);
+        else
+            printf("unknown option: %s\n", argv[i]);
+
+    if (list || find_key)   // query an existing index
+    {
+        RomIndex index;
+
+        if (!rom_index_open(&index, index_name))
+            return -1;
+
+        const RomIndexEntry *entry = NULL;
+
+        if (find_key && (entry = rom_index_find(&index, find_key)))
+            print_entry(&index, entry);
+        else if (find_key)
+            printf("%s: not found\n", find_key);
+        else
+            for (uint32_t i = 0; i < index.header->count; i++)
+                print_entry(&index, &index.entries[i]);
+
+        rom_index_close(&index);
+
+        return find_key && !entry;
+    }
+
+    if (!path_count)
+        return usage(argv[0]);
+
+    if (jobs < 1)
+        jobs = 1;
+    if (jobs > path_count)
+        jobs = path_count;
+
+    uint32_t count;
+    RomIndexEntry *entries = scan(jobs, &count);
+
+    if (!entries || !rom_index_write(index_name, entries, paths, count))
+        return -1;
+
+    printf("%u of %u ROMs indexed in %s\n", count, path_count, index_name);
+
+    return count != path_count;
+}
\ No newline at end of file
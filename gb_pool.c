@@ -0,0 +1,292 @@
+#include "gameboy.h"
+#include "cartridge.h"
+#include "PPU.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// warm pool daemon: the ROM is loaded and booted once, then worker processes are forked from that frame 0
+// instance and wait on the listening socket. fork clones the whole machine copy-on-write (the ROM mapping and
+// untouched state stay shared), so a session never goes through cartridge_load or the module inits - each
+// worker serves one session and exits, and the daemon forks a fresh one from the same frame 0 in its place
+//
+// session protocol (Unix domain stream socket), requests of REQUEST_SIZE bytes:
+//   POOL_RUN     buttons, frames (4 bytes little-endian)   run with buttons held - reply: last video frame
+//   POOL_SERIAL                                           reply: length (4 bytes little-endian) + serial bytes since last request
+// closing the connection ends the session
+
+#define DEFAULT_WORKERS                4
+#define REQUEST_SIZE                   6
+#define SERIAL_BUFFER_SIZE        0x10000
+
+enum PoolCommand { POOL_RUN = 1, POOL_SERIAL = 2 };
+
+static volatile sig_atomic_t stopping;
+
+/**** worker ****/
+static uint32_t pixels[DISPLAY_WIDTH * DISPLAY_HEIGHT];   // last completed frame
+static uint8_t held_buttons;
+static uint8_t serial_output[SERIAL_BUFFER_SIZE];
+static uint32_t serial_length;
+
+static void video_frame(const uint32_t *frame)
+{
+    memcpy(pixels, frame, sizeof pixels);
+}
+
+static uint8_t input(void)
+{
+    return held_buttons;
+}
+
+static void serial_byte(uint8_t data)
+{
+    if (serial_length < SERIAL_BUFFER_SIZE)
+        serial_output[serial_length++] = data;
+}
+
+static Frontend frontend_pool = { video_frame, NULL, input, NULL, serial_byte, NULL };
+
+static int send_all(int fd, const void *data, size_t length)
+{
+    const uint8_t *p = (const uint8_t*)data;
+
+    while (length)
+    {
+        ssize_t result = send(fd, p, length, MSG_NOSIGNAL);
+
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return 0;
+
+        p += result;
+        length -= result;
+    }
+
+    return 1;
+}
+
+static int receive_all(int fd, void *data, size_t length)
+{
+    uint8_t *p = (uint8_t*)data;
+
+    while (length)
+    {
+        ssize_t result = recv(fd, p, length, 0);
+
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return 0;   // session closed
+
+        p += result;
+        length -= result;
+    }
+
+    return 1;
+}
+
+static void serve_session(int session)
+{
+    uint8_t request[REQUEST_SIZE];
+
+    while (receive_all(session, request, sizeof request))
+        if (request[0] == POOL_RUN)
+        {
+            uint32_t frames = request[2] | request[3] << 8 | request[4] << 16 | (uint32_t)request[5] << 24;
+
+            held_buttons = request[1];
+            while (frames--)
+                gameboy_run_frame();
+
+            if (!send_all(session, pixels, sizeof pixels))
+                return;
+        }
+        else if (request[0] == POOL_SERIAL)
+        {
+            uint8_t length[4] = { serial_length & 0xFF, serial_length >> 8 & 0xFF, serial_length >> 16 & 0xFF, serial_length >> 24 };
+
+            if (!send_all(session, length, sizeof length) || !send_all(session, serial_output, serial_length))
+                return;
+            serial_length = 0;
+        }
+        else
+        {
+            printf("unknown pool request: %d\n", request[0]);
+            return;
+        }
+}
+
+static void worker(int listener)
+{
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+
+    int session;
+    while ((session = accept(listener, NULL, NULL)) < 0)
+        if (errno != EINTR)
+        {
+            printf("error accepting session: %s\n", strerror(errno));
+            _exit(1);
+        }
+
+    close(listener);
+    serve_session(session);
+    close(session);
+
+    _exit(0);   // nothing to clean up: the instance dies with its session
+}
+
+/**** daemon ****/
+static void stop(int signal_number)
+{
+    stopping = 1;
+}
+
+static pid_t spawn_worker(int listener)
+{
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == 0)
+        worker(listener);
+    else if (pid < 0)
+        printf("error forking worker: %s\n", strerror(errno));
+
+    return pid;
+}
+
+static int listen_socket(const char *path)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof address.sun_path)
+    {
+        printf("error: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == -1)
+    {
+        printf("error creating socket\n");
+        return -1;
+    }
+
+    struct stat path_stat;
+    if (lstat(path, &path_stat) == 0 && S_ISSOCK(path_stat.st_mode))
+        unlink(path);   // stale socket from a previous run, anything else at the path makes bind fail
+    if (bind(listener, (struct sockaddr*)&address, sizeof address) == -1 || listen(listener, 64) == -1)
+    {
+        printf("error listening on %s: %s\n", path, strerror(errno));
+        close(listener);
+        return -1;
+    }
+
+    return listener;
+}
+
+static int usage(const char *program)
+{
+    printf("usage: %s <ROM name> --listen=socket [-n workers] [--boot=fast|rom | --boot-cache=dir]\n", program);
+
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *rom_name = NULL;
+    const char *socket_path = NULL;
+    int workers = DEFAULT_WORKERS;
+    BootMode boot_mode = BOOT_MODE_FAST;
+    const char *boot_cache = NULL;   // post-boot snapshots directory
+
+    for (int i = 1; i < argc; i++)
+        if (strncmp(argv[i], "-n", 2) == 0)
+        {
+            if (!argv[i][2] && i + 1 == argc)   // -n without a count
+                return usage(argv[0]);
+            workers = strtol(argv[i][2] ? argv[i] + 2 : argv[++i], NULL, 10);
+        }
+        else if (strncmp(argv[i], "--listen=", 9) == 0)
+            socket_path = argv[i] + 9;
+        else if (strcmp(argv[i], "--boot=fast") == 0)
+            boot_mode = BOOT_MODE_FAST;
+        else if (strcmp(argv[i], "--boot=rom") == 0)
+            boot_mode = BOOT_MODE_ROM;
+        else if (strncmp(argv[i], "--boot-cache=", 13) == 0)
+            boot_mode = BOOT_MODE_ROM, boot_cache = argv[i] + 13;
+        else if (argv[i][0] != '-')
+            rom_name = argv[i];
+        else
+            printf("unknown option: %s\n", argv[i]);
+
+    if (!rom_name || !socket_path)
+        return usage(argv[0]);
+
+    if (workers < 1)
+        workers = 1;
+
+    /**** reference instance: loaded, booted and waiting at frame 0 ****/
+    if (!cartridge_load(rom_name, NULL))
+        return -1;
+    cartridge_detach_save();   // sessions start from the save as it is now and never write it back
+
+    gameboy_set_boot_mode(boot_mode, boot_cache);
+    if (!gameboy_init(&frontend_pool, 0) || !gameboy_boot())   // audio disabled
+        return -1;
+
+    int listener = listen_socket(socket_path);
+    if (listener == -1)
+        return -1;
+
+    struct sigaction action = { .sa_handler = stop };   // no SA_RESTART: waitpid returns on the signal
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+
+    pid_t *pids = (pid_t*)calloc(workers, sizeof(pid_t));
+    for (int i = 0; i < workers; i++)
+        pids[i] = spawn_worker(listener);
+
+    printf("%s: %d workers on %s\n", rom_name, workers, socket_path);
+    fflush(stdout);
+
+    /**** replace every worker whose session ended ****/
+    while (!stopping)
+    {
+        pid_t pid = waitpid(-1, NULL, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < workers; i++)
+            if (pids[i] == pid)
+                pids[i] = stopping ? -1 : spawn_worker(listener);
+    }
+
+    for (int i = 0; i < workers; i++)
+        if (pids[i] > 0)
+            kill(pids[i], SIGTERM);
+    while (wait(NULL) > 0)
+        ;
+
+    close(listener);
+    unlink(socket_path);
+    free(pids);
+
+    gameboy_deinit();
+    cartridge_unload();
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,268 @@
+#include "gameboy.h"
+#include "cartridge.h"
+#include "APU.h"
+#include "DMA.h"
+#include "wav.h"
+#include "link.h"
+#include "input.h"
+#include "rom_index.h"
+#include "perf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// headless front end: no display, audio device or input - links against the emulation core only
+
+#define DEFAULT_FRAMES               600     // 10 seconds of emulated time
+
+static Frontend frontend_headless = { NULL, NULL, NULL, NULL, NULL, NULL };
+
+// ROM name, or hash or title looked up in a gb-index ROM library index
+static int load_ROM(const char *rom_name, const char *index_name, const char *patch_path)
+{
+    if (!index_name)
+        return cartridge_load(rom_name, patch_path);
+
+    RomIndex index;
+    if (!rom_index_open(&index, index_name))
+        return 0;
+
+    const RomIndexEntry *entry = rom_index_find(&index, rom_name);
+    int loaded = 0;
+
+    if (!entry)
+        printf("error: %s not found in %s\n", rom_name, index_name);
+    else
+        loaded = cartridge_load_file(rom_index_path(&index, entry), patch_path);
+
+    rom_index_close(&index);
+
+    return loaded;
+}
+
+static WavWriter wav;         // mixed stereo output
+static WavWriter stems[4];    // one mono file per APU channel
+
+static void audio_samples(const int16_t *samples, int length)
+{
+    wav_write(&wav, samples, length);
+}
+
+static void serial_byte(uint8_t data)
+{
+    putchar(data);
+}
+
+static void channel_samples(const int16_t *samples, int length)
+{
+    int16_t channel[1024];
+
+    for (int i = 0; i < 4; i++)
+        for (int offset = 0; offset < length; offset += 1024 * 4)
+        {
+            int count = (length - offset) / 4 < 1024 ? (length - offset) / 4 : 1024;
+
+            for (int j = 0; j < count; j++)
+                channel[j] = samples[offset + j * 4 + i];
+
+            wav_write(&stems[i], channel, count);
+        }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *rom_name = NULL;
+    long frames = DEFAULT_FRAMES;
+    const char *wav_name = NULL;     // mixed output file
+    const char *stems_name = NULL;   // stem files prefix: <prefix>_channel1.wav -- <prefix>_channel4.wav
+    uint32_t sampling_frequency = SAMPLING_FREQUENCY;
+    const char *patch_path = NULL;      // IPS or BPS patch applied to the ROM
+    const char *index_name = NULL;      // ROM names are hashes or titles in this ROM library index
+    const char *link_rom_name = NULL;   // ROM run by a second instance connected through the link cable
+    int link_side = 0;
+    pid_t link_pid = -1;
+    const char *link_listen = NULL;     // Unix domain socket path the peer process connects to
+    const char *link_connect_path = NULL;
+    BootMode boot_mode = BOOT_MODE_ROM;
+    const char *boot_cache = NULL;      // post-boot snapshots directory
+    int perf = 0;                       // report hardware performance counters per emulated frame
+
+    for (int i = 1; i < argc; i++)
+        if (strncmp(argv[i], "--frames=", 9) == 0)
+            frames = strtol(argv[i] + 9, NULL, 10);
+        else if (strncmp(argv[i], "--wav=", 6) == 0)
+            wav_name = argv[i] + 6;
+        else if (strncmp(argv[i], "--stems=", 8) == 0)
+            stems_name = argv[i] + 8;
+        else if (strncmp(argv[i], "--audio-rate=", 13) == 0)
+            sampling_frequency = strtoul(argv[i] + 13, NULL, 10);
+        else if (strcmp(argv[i], "--no-audio") == 0)
+            sampling_frequency = 0;
+        else if (strncmp(argv[i], "--input-script=", 15) == 0)
+        {
+            if (!input_script_load(argv[i] + 15))
+                return -1;
+
+            frontend_headless.input = input_script;
+        }
+        else if (strncmp(argv[i], "--patch=", 8) == 0)
+            patch_path = argv[i] + 8;
+        else if (strncmp(argv[i], "--index=", 8) == 0)
+            index_name = argv[i] + 8;
+        else if (strcmp(argv[i], "--perf") == 0)
+            perf = 1;
+        else if (strcmp(argv[i], "--serial") == 0)
+            frontend_headless.serial_byte = serial_byte;
+        else if (strncmp(argv[i], "--link=", 7) == 0)
+            link_rom_name = argv[i] + 7;
+        else if (strncmp(argv[i], "--link-listen=", 14) == 0)
+            link_listen = argv[i] + 14;
+        else if (strncmp(argv[i], "--link-connect=", 15) == 0)
+            link_connect_path = argv[i] + 15;
+        else if (strcmp(argv[i], "--dma=exact") == 0)
+            DMA_set_mode(DMA_MODE_EXACT);
+        else if (strcmp(argv[i], "--dma=fast") == 0)
+            DMA_set_mode(DMA_MODE_FAST);
+        else if (strcmp(argv[i], "--boot=fast") == 0)
+            boot_mode = BOOT_MODE_FAST;
+        else if (strncmp(argv[i], "--boot-cache=", 13) == 0)
+            boot_cache = argv[i] + 13;
+        else if (argv[i][0] != '-')
+            rom_name = argv[i];
+        else
+            printf("unknown option: %s\n", argv[i]);
+
+    if (!rom_name)
+    {
+        printf("usage: %s <ROM name> [--frames=N] [--wav=file] [--stems=prefix] [--audio-rate=N | --no-audio] [--dma=fast|exact] [--boot=fast | --boot-cache=dir] [--index=file] [--patch=file] [--serial] [--perf] [--input-script=file] [--link=ROM name | --link-listen=socket | --link-connect=socket]\n", argv[0]);
+        return -1;
+    }
+
+    if (link_rom_name)   // fork the second instance: the emulation core is a single instance per process
+    {
+        if (!link_shm_create())
+        {
+            printf("error creating link cable\n");
+            return -1;
+        }
+
+        if ((link_pid = fork()) < 0)
+        {
+            printf("error starting linked instance\n");
+            return -1;
+        }
+
+        if (link_pid == 0)
+        {
+            rom_name = link_rom_name;
+            link_side = 1;
+            wav_name = stems_name = NULL;   // output files belong to the first instance
+        }
+    }
+
+    if (!load_ROM(rom_name, index_name, patch_path))
+    {
+        if (link_rom_name)   // don't leave the peer waiting
+            link_shm_transport(link_side)->close();
+
+        return -1;
+    }
+
+    if ((wav_name || stems_name) && !sampling_frequency)
+    {
+        printf("error: WAV output needs audio enabled\n");
+        return -1;
+    }
+
+    if (wav_name)
+    {
+        if (!wav_open(&wav, wav_name, 2, sampling_frequency))
+            return -1;
+
+        frontend_headless.audio_samples = audio_samples;
+    }
+
+    if (stems_name)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            char stem_name[256];
+            snprintf(stem_name, sizeof stem_name, "%s_channel%d.wav", stems_name, i + 1);
+
+            if (!wav_open(&stems[i], stem_name, 1, sampling_frequency))
+                return -1;
+        }
+
+        frontend_headless.channel_samples = channel_samples;
+    }
+
+    gameboy_set_boot_mode(boot_mode, boot_cache);
+
+    if (!gameboy_init(&frontend_headless, sampling_frequency))
+        return -1;
+
+    if (link_rom_name)
+        link_connect(link_shm_transport(link_side));
+    else if (link_listen || link_connect_path)
+    {
+        const LinkTransport *transport = link_listen ? link_socket_listen(link_listen) : link_socket_connect(link_connect_path);
+
+        if (!transport)
+            return -1;
+
+        link_connect(transport);
+    }
+
+    if (perf && !perf_open())
+        printf("hardware performance counters unavailable\n");
+
+    PerfCounters counters, start_counters;
+    perf_read(&start_counters);
+    double start = seconds();
+
+    for (long frame = 0; frame < frames; frame++)
+        gameboy_run_frame();
+
+    double elapsed = seconds() - start;
+    double emulated = (double)frames * FRAME_CYCLES / CLOCK_FREQUENCY;
+    perf_read(&counters);
+    perf_elapsed(&counters, &start_counters);
+
+    printf("%s: %ld frames in %.3f s - %.1f fps - %.1fx real time\n", rom_name, frames, elapsed, frames / elapsed, emulated / elapsed);
+
+    if (perf && frames > 0)
+    {
+        if (perf_available(PERF_CYCLES) && perf_available(PERF_INSTRUCTIONS) && counters.value[PERF_CYCLES])
+            printf("%.2f IPC\n", (double)counters.value[PERF_INSTRUCTIONS] / counters.value[PERF_CYCLES]);
+
+        for (int i = 0; i < PERF_COUNTERS; i++)
+            if (perf_available(i))
+                printf("%.0f %s per frame\n", (double)counters.value[i] / frames, perf_name(i));
+    }
+
+    perf_close();   // counters are open even when no frame ran
+
+    gameboy_deinit();
+    cartridge_unload();
+
+    wav_close(&wav);
+
+    for (int i = 0; i < 4; i++)
+        wav_close(&stems[i]);
+
+    if (link_pid > 0)
+        waitpid(link_pid, NULL, 0);
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "input.h"
+#include "joypad.h"
+#include "gameboy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct InputEvent
+{
+    uint64_t frame;
+    uint8_t buttons;
+} InputEvent;
+
+static const char *button_names[] = { "RIGHT", "LEFT", "UP", "DOWN", "A", "B", "SELECT", "START" };
+
+/**** script / replay ****/
+static InputEvent *events;
+static int event_count;
+static int next_event;
+static uint8_t script_buttons;
+
+// input is sampled at clock cycles that are multiples of FRAME_CYCLES
+static uint64_t input_frame(void)
+{
+    return clock_cycles / FRAME_CYCLES;
+}
+
+static int parse_buttons(char *text, uint8_t *buttons)
+{
+    *buttons = 0x00;
+
+    if (strcmp(text, "-") == 0)
+        return 1;
+
+    for (char *name = strtok(text, "+"); name; name = strtok(NULL, "+"))
+    {
+        int i;
+
+        for (i = 0; i < 8 && strcmp(name, button_names[i]) != 0; i++)
+            ;
+
+        if (i == 8)
+            return 0;
+
+        *buttons |= 1 << i;
+    }
+
+    return 1;
+}
+
+int input_script_load(const char *file_name)
+{
+    FILE *file = fopen(file_name, "r");
+    if (!file)
+    {
+        printf("error opening input script: %s\n", file_name);
+        return 0;
+    }
+
+    char line[256], buttons[200];
+    unsigned long long frame;
+    int capacity = 0;
+
+    event_count = next_event = 0;
+    script_buttons = 0x00;
+
+    for (int number = 1; fgets(line, sizeof line, file); number++)
+    {
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        if (event_count == capacity)
+            events = realloc(events, (capacity = capacity ? capacity * 2 : 256) * sizeof(InputEvent));
+
+        if (sscanf(line, "%llu %199s", &frame, buttons) != 2 || !parse_buttons(buttons, &events[event_count].buttons))
+        {
+            printf("error in input script %s line %d\n", file_name, number);
+            fclose(file);
+            return 0;
+        }
+
+        events[event_count++].frame = frame;
+    }
+
+    fclose(file);
+
+    return 1;
+}
+
+uint8_t input_script(void)
+{
+    uint64_t frame = input_frame();
+
+    while (next_event < event_count && events[next_event].frame <= frame)
+        script_buttons = events[next_event++].buttons;
+
+    return script_buttons;
+}
+
+/**** recording ****/
+static FILE *record_file;
+static uint8_t (*record_source)(void);
+static int recorded_buttons = -1;
+
+static uint8_t recorded_input(void)
+{
+    uint8_t buttons = record_source ? record_source() : 0x00;
+
+    if (buttons != recorded_buttons)
+    {
+        fprintf(record_file, "%llu ", (unsigned long long)input_frame());
+
+        if (!buttons)
+            fputc('-', record_file);
+
+        for (int i = 0, first = 1; i < 8; i++)
+            if (buttons & 1 << i)
+            {
+                fprintf(record_file, first ? "%s" : "+%s", button_names[i]);
+                first = 0;
+            }
+
+        fputc('\n', record_file);
+
+        recorded_buttons = buttons;
+    }
+
+    return buttons;
+}
+
+uint8_t (*input_record(const char *file_name, uint8_t (*source)(void)))(void)
+{
+    record_file = fopen(file_name, "w");
+    if (!record_file)
+    {
+        printf("error creating input recording: %s\n", file_name);
+        return NULL;
+    }
+
+    record_source = source;
+    recorded_buttons = -1;
+
+    return recorded_input;
+}
+
+void input_record_stop(void)
+{
+    if (record_file)
+        fclose(record_file);
+
+    record_file = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdint.h>
+
+// front end independent input sources - scripts and recordings share a text format, one line per change:
+// <frame> <buttons>   buttons: RIGHT, LEFT, UP, DOWN, A, B, SELECT, START joined with '+', or '-' for none
+
+int input_script_load(const char *file_name);
+uint8_t input_script(void);    // Frontend input callback playing the loaded script or recording
+
+uint8_t (*input_record(const char *file_name, uint8_t (*source)(void)))(void);   // wraps source, returns NULL on error
+void input_record_stop(void);
+
+#endif  // __INPUT_H__
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "instruction_set.h"
 #include "CPU.h"
 #include "bus.h"
+#include <stddef.h>
 
 /**** 8-bit Load Commands ****/
 
@@ -1,31 +1,71 @@
 #include "joypad.h"
-#include "SDL2/SDL.h"
+#include "frontend.h"
+#include "gameboy.h"
+#include "bus.h"
 
-static uint8_t joypad;
+#define SELECT_DIRECTIONS      0x10    // P14 low: direction keys selected
+#define SELECT_BUTTONS         0x20    // P15 low: button keys selected
+
+static uint8_t joypad = SELECT_DIRECTIONS | SELECT_BUTTONS;   // key group select lines
+static uint8_t buttons;                                       // pressed buttons latched from the front end (enum Button bits)
+
+uint64_t joypad_next_latch;
+
+// P10 - P13 input lines, low when a key of a selected group is pressed
+static uint8_t joypad_lines(void)
+{
+	uint8_t pressed = 0x00;
+
+	if (!(joypad & SELECT_DIRECTIONS))
+		pressed |= buttons & 0x0F;
+	if (!(joypad & SELECT_BUTTONS))
+		pressed |= buttons >> 4;
+
+	return ~pressed & 0x0F;
+}
+
+static void joypad_update(uint8_t old_lines)
+{
+	if (old_lines & ~joypad_lines())   // any input line went from high to low
+		set_int_flag(INT_JOYPAD);
+}
+
+void joypad_init(void)
+{
+	joypad = SELECT_DIRECTIONS | SELECT_BUTTONS;
+	buttons = 0x00;
+
+	joypad_next_latch = clock_cycles;
+}
+
+// front end input is sampled once per frame at fixed clock cycles, so the emulation thread never calls into
+// the front end while reading 0xFF00 and scripted or replayed input lands on exactly the same cycle every run
+void joypad_latch(void)
+{
+	uint8_t old_lines = joypad_lines();
+
+	buttons = frontend.input ? frontend.input() : 0x00;
+	joypad_update(old_lines);
+
+	joypad_next_latch += FRAME_CYCLES;
+}
+
+void joypad_state(State *state)
+{
+	state_io(state, &joypad, sizeof joypad);
+	state_io(state, &buttons, sizeof buttons);
+	state_io(state, &joypad_next_latch, sizeof joypad_next_latch);
+}
 
 uint8_t joypad_read(void)
 {
-	const uint8_t *keyboard_state = SDL_GetKeyboardState(NULL);
-
-	int right = keyboard_state[SDL_SCANCODE_RIGHT];
-	int left = keyboard_state[SDL_SCANCODE_LEFT];
-	int up = keyboard_state[SDL_SCANCODE_UP];
-	int down = keyboard_state[SDL_SCANCODE_DOWN];
-
-	int A = keyboard_state[SDL_SCANCODE_A];
-	int B = keyboard_state[SDL_SCANCODE_S];
-	int select = keyboard_state[SDL_SCANCODE_Q];
-	int start = keyboard_state[SDL_SCANCODE_W];
-
-	if (joypad >> 4 == 2)
-		return ~(down << 3 | up << 2 | left << 1 | right) & 0x0F;
-	else if (joypad >> 4 == 1)
-		return ~(start << 3 | select << 2 | B << 1 | A) & 0x0F;
-	else
-		return 0xFF;
+	return 0xC0 | joypad | joypad_lines();
 }
 
 void joypad_write(uint8_t data)
 {
-	joypad = joypad & 0xCF | data;
+	uint8_t old_lines = joypad_lines();
+
+	joypad = data & (SELECT_DIRECTIONS | SELECT_BUTTONS);
+	joypad_update(old_lines);
 }
\ No newline at end of file
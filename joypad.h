@@ -2,6 +2,19 @@
 #define __JOYPAD_H__
 
 #include <stdint.h>
+#include "state.h"
+
+enum Button 
+{ 
+	BUTTON_RIGHT = 0x01, BUTTON_LEFT = 0x02, BUTTON_UP = 0x04, BUTTON_DOWN = 0x08, 
+	BUTTON_A = 0x10, BUTTON_B = 0x20, BUTTON_SELECT = 0x40, BUTTON_START = 0x80 
+};
+
+extern uint64_t joypad_next_latch;   // clock cycle front end input is sampled at next
+
+void joypad_init(void);
+void joypad_latch(void);
+void joypad_state(State *state);
 
 uint8_t joypad_read(void);
 void joypad_write(uint8_t data);
@@ -0,0 +1,136 @@
+#include "link.h"
+#include "serial.h"
+#include "gameboy.h"
+
+static const LinkTransport *link;
+
+static uint64_t peer_time;       // last clock cycle published by the peer
+static int reply_received;
+static uint8_t reply;
+
+static int transfer_pending;     // peer's transfer timestamped ahead of our clock, delivered once we get there
+static LinkMessage pending_transfer;
+
+uint64_t link_sync_time = UINT64_MAX;
+
+void link_connect(const LinkTransport *transport)
+{
+    link = transport;
+
+    peer_time = clock_cycles;
+    reply_received = 0;
+    transfer_pending = 0;
+    link_sync_time = clock_cycles + LINK_QUANTUM;
+
+    if (link_sync_time < serial_next_event)
+        serial_next_event = link_sync_time;
+}
+
+void link_disconnect(void)
+{
+    if (!link)
+        return;
+
+    LinkMessage message = { clock_cycles, LINK_BYE, 0 };
+    link->send(&message);
+    link->close();
+
+    link = 0;
+    link_sync_time = UINT64_MAX;
+}
+
+int link_connected(void)
+{
+    return link != 0;
+}
+
+// peer stopped emulating: stop waiting for it, pending transfer shifts in 1s
+static void link_peer_gone(void)
+{
+    peer_time = UINT64_MAX / 2;
+    reply = 0xFF;
+    reply_received = 1;
+}
+
+static void link_send(LinkMessageType type, uint8_t data)
+{
+    LinkMessage message = { clock_cycles, type, data };
+
+    if (!link->send(&message))
+        link_peer_gone();
+}
+
+static void link_handle(const LinkMessage *message)
+{
+    if (message->time > peer_time && message->type != LINK_BYE)
+        peer_time = message->time;
+
+    switch (message->type)
+    {
+        case LINK_TRANSFER:
+            pending_transfer = *message;
+            transfer_pending = 1;
+            break;
+        case LINK_REPLY:
+            reply = message->data;
+            reply_received = 1;
+            break;
+        case LINK_BYE:
+            link_peer_gone();
+            break;
+    }
+}
+
+static void link_poll(void)
+{
+    LinkMessage message;
+    int result;
+
+    while ((result = link->receive(&message)) > 0)
+        link_handle(&message);
+
+    if (result < 0)
+        link_peer_gone();
+
+    // a transfer is not delivered before our clock reaches it: the game may not have re-armed SC yet
+    if (transfer_pending && clock_cycles >= pending_transfer.time)
+    {
+        transfer_pending = 0;
+        link_send(LINK_REPLY, serial_external_transfer(pending_transfer.data));
+    }
+}
+
+void link_sync(void)
+{
+    link_send(LINK_SYNC, 0);
+    link_poll();
+
+    while (clock_cycles > peer_time + LINK_MAX_AHEAD)   // out of budget: wait for the peer to catch up
+    {
+        link->idle();
+        link_poll();
+    }
+
+    link_sync_time = clock_cycles + LINK_QUANTUM;
+}
+
+void link_transfer(uint8_t data)
+{
+    reply_received = 0;
+
+    link_send(LINK_TRANSFER, data);
+}
+
+// the byte clocked out with the internal clock has been shifted: wait for the peer's byte
+uint8_t link_wait_reply(void)
+{
+    link_poll();
+
+    while (!reply_received)
+    {
+        link->idle();
+        link_poll();
+    }
+
+    return reply;
+}
\ No newline at end of file
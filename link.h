@@ -0,0 +1,54 @@
+#ifndef __LINK_H__
+#define __LINK_H__
+
+#include <stdint.h>
+
+// link cable between two emulator instances: serial transfers are exchanged as timestamped messages and
+// each side publishes its clock every LINK_QUANTUM cycles, running at most LINK_MAX_AHEAD cycles ahead of its peer
+
+#define LINK_QUANTUM              1024    // clock cycles between sync points
+#define LINK_MAX_AHEAD           32768    // clock cycles an instance may run ahead of its peer
+
+typedef enum LinkMessageType
+{
+    LINK_SYNC,         // sender's clock reached time
+    LINK_TRANSFER,     // sender clocked data out with its internal clock at time
+    LINK_REPLY,        // byte shifted back by the externally clocked side
+    LINK_BYE           // sender stopped emulating
+} LinkMessageType;
+
+typedef struct LinkMessage
+{
+    uint64_t time;
+    uint8_t type;
+    uint8_t data;
+} LinkMessage;
+
+// message transport - both ends must preserve message order
+typedef struct LinkTransport
+{
+    int (*send)(const LinkMessage *message);
+    int (*receive)(LinkMessage *message);   // non-blocking: 1 message read, 0 none available, -1 peer gone
+    void (*idle)(void);                     // wait a little for the peer to make progress
+    void (*close)(void);
+} LinkTransport;
+
+extern uint64_t link_sync_time;   // clock cycle of next sync point (UINT64_MAX: not connected)
+
+void link_connect(const LinkTransport *transport);   // after gameboy_init
+void link_disconnect(void);
+int link_connected(void);
+
+void link_sync(void);
+void link_transfer(uint8_t data);
+uint8_t link_wait_reply(void);
+
+/**** in-process transports ****/
+int link_shm_create(void);         // before fork: shared message rings between parent and child
+const LinkTransport *link_shm_transport(int side);   // 0: parent, 1: child
+
+/**** inter-process transports ****/
+const LinkTransport *link_socket_listen(const char *path);    // blocks until the peer connects
+const LinkTransport *link_socket_connect(const char *path);
+
+#endif  // __LINK_H__
\ No newline at end of file
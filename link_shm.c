@@ -0,0 +1,91 @@
+#include "link.h"
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sched.h>
+
+// in-process link: two instances forked from the same process exchange messages through
+// single-producer/single-consumer lock-free rings in an anonymous shared mapping
+
+#define RING_SIZE           256    // messages - power of two
+
+typedef struct MessageRing
+{
+    atomic_uint read;      // free-running, written by the consumer only
+    atomic_uint write;     // free-running, written by the producer only
+    LinkMessage messages[RING_SIZE];
+} MessageRing;
+
+typedef struct SharedLink
+{
+    MessageRing rings[2];  // ring i carries messages to side i
+    atomic_int closed[2];
+} SharedLink;
+
+static SharedLink *shared;
+static int side;
+
+static int shm_send(const LinkMessage *message)
+{
+    MessageRing *ring = &shared->rings[side ^ 1];
+    unsigned write = atomic_load_explicit(&ring->write, memory_order_relaxed);
+
+    while (write - atomic_load_explicit(&ring->read, memory_order_acquire) == RING_SIZE)   // full: wait for the peer to drain it
+    {
+        if (atomic_load_explicit(&shared->closed[side ^ 1], memory_order_acquire))
+            return 0;
+
+        sched_yield();
+    }
+
+    ring->messages[write & (RING_SIZE - 1)] = *message;
+    atomic_store_explicit(&ring->write, write + 1, memory_order_release);
+
+    return 1;
+}
+
+static int shm_receive(LinkMessage *message)
+{
+    MessageRing *ring = &shared->rings[side];
+    unsigned read = atomic_load_explicit(&ring->read, memory_order_relaxed);
+
+    if (read == atomic_load_explicit(&ring->write, memory_order_acquire))
+        return atomic_load_explicit(&shared->closed[side ^ 1], memory_order_acquire) ? -1 : 0;
+
+    *message = ring->messages[read & (RING_SIZE - 1)];
+    atomic_store_explicit(&ring->read, read + 1, memory_order_release);
+
+    return 1;
+}
+
+static void shm_idle(void)
+{
+    sched_yield();
+}
+
+static void shm_close(void)
+{
+    atomic_store_explicit(&shared->closed[side], 1, memory_order_release);
+}
+
+static const LinkTransport shm_transport = { shm_send, shm_receive, shm_idle, shm_close };
+
+int link_shm_create(void)
+{
+    shared = mmap(NULL, sizeof(SharedLink), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (shared == MAP_FAILED)
+    {
+        shared = NULL;
+        return 0;
+    }
+
+    // anonymous mappings are zero filled: rings are empty and both sides open
+    return 1;
+}
+
+const LinkTransport *link_shm_transport(int link_side)
+{
+    side = link_side;
+
+    return &shm_transport;
+}
\ No newline at end of file
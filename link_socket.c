@@ -0,0 +1,195 @@
+#include "link.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+// link between processes over a Unix domain stream socket - messages are batched: sync points only go out
+// once the clock advanced LINK_SOCKET_BATCH cycles past the last one sent (or when waiting on the peer),
+// transfers and replies are flushed right away since the peer may be waiting for them
+
+#define LINK_SOCKET_BATCH         (LINK_MAX_AHEAD / 2)
+#define MESSAGE_SIZE              10      // wire format: time (8 bytes little-endian), type, data
+#define BUFFER_SIZE               (MESSAGE_SIZE * 256)
+
+static int socket_fd = -1;
+
+static uint8_t output[BUFFER_SIZE];
+static int output_length;
+static int pending_sync;             // last buffered message is a sync point that a newer one can replace
+static uint64_t flushed_time;        // time of last sync point sent
+
+static uint8_t input[BUFFER_SIZE];
+static int input_length;
+
+static int socket_flush(void)
+{
+    int sent = 0;
+
+    while (sent < output_length)
+    {
+        ssize_t result = send(socket_fd, output + sent, output_length - sent, MSG_NOSIGNAL);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return 0;
+
+            struct pollfd pfd = { socket_fd, POLLOUT, 0 };
+            poll(&pfd, 1, -1);
+        }
+        else
+            sent += result;
+    }
+
+    output_length = 0;
+    pending_sync = 0;
+
+    return 1;
+}
+
+static int socket_send(const LinkMessage *message)
+{
+    if (message->type == LINK_SYNC && pending_sync)   // coalesce consecutive sync points
+        output_length -= MESSAGE_SIZE;
+    else if (output_length + MESSAGE_SIZE > BUFFER_SIZE && !socket_flush())
+        return 0;
+
+    uint8_t *p = output + output_length;
+
+    for (int i = 0; i < 8; i++)
+        p[i] = message->time >> i * 8 & 0xFF;
+    p[8] = message->type;
+    p[9] = message->data;
+
+    output_length += MESSAGE_SIZE;
+    pending_sync = message->type == LINK_SYNC;
+
+    if (message->type == LINK_SYNC && message->time - flushed_time < LINK_SOCKET_BATCH)
+        return 1;
+
+    if (message->type == LINK_SYNC)
+        flushed_time = message->time;
+
+    return socket_flush();
+}
+
+static int socket_receive(LinkMessage *message)
+{
+    if (input_length < MESSAGE_SIZE)
+    {
+        ssize_t result = recv(socket_fd, input + input_length, BUFFER_SIZE - input_length, 0);
+
+        if (result == 0)
+            return -1;   // peer closed the connection
+        if (result < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+
+        input_length += result;
+
+        if (input_length < MESSAGE_SIZE)
+            return 0;
+    }
+
+    message->time = 0;
+    for (int i = 0; i < 8; i++)
+        message->time |= (uint64_t)input[i] << i * 8;
+    message->type = input[8];
+    message->data = input[9];
+
+    input_length -= MESSAGE_SIZE;
+    memmove(input, input + MESSAGE_SIZE, input_length);
+
+    return 1;
+}
+
+// waiting on the peer: make sure it has our latest sync point, then sleep until it sends something
+static void socket_idle(void)
+{
+    if (output_length)
+        socket_flush();
+
+    struct pollfd pfd = { socket_fd, POLLIN, 0 };
+    poll(&pfd, 1, 1);
+}
+
+static void socket_close(void)
+{
+    socket_flush();
+
+    close(socket_fd);
+    socket_fd = -1;
+}
+
+static const LinkTransport socket_transport = { socket_send, socket_receive, socket_idle, socket_close };
+
+static const LinkTransport *socket_ready(int fd)
+{
+    socket_fd = fd;
+    fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
+
+    output_length = input_length = 0;
+    pending_sync = 0;
+    flushed_time = 0;
+
+    return &socket_transport;
+}
+
+const LinkTransport *link_socket_listen(const char *path)
+{
+    struct sockaddr_un address = { 0 };
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof address.sun_path - 1);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct stat path_stat;
+    if (lstat(path, &path_stat) == 0 && S_ISSOCK(path_stat.st_mode))
+        unlink(path);   // stale socket from a previous run, anything else at the path makes bind fail
+
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&address, sizeof address) < 0 || listen(listen_fd, 1) < 0)
+    {
+        printf("error listening on link socket %s: %s\n", path, strerror(errno));
+        if (listen_fd >= 0)
+            close(listen_fd);
+        return NULL;
+    }
+
+    int fd = accept(listen_fd, NULL, NULL);   // blocks until the peer connects
+
+    close(listen_fd);
+    unlink(path);
+
+    if (fd < 0)
+    {
+        printf("error accepting link connection: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    return socket_ready(fd);
+}
+
+const LinkTransport *link_socket_connect(const char *path)
+{
+    struct sockaddr_un address = { 0 };
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof address.sun_path - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof address) < 0)
+    {
+        printf("error connecting to link socket %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    return socket_ready(fd);
+}
\ No newline at end of file
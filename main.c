@@ -1,15 +1,87 @@
-#include "CPU.h"
-#include "PPU.h"
+#include "gameboy.h"
+#include "frontend_SDL.h"
+#include "cartridge.h"
 #include "APU.h"
 #include "DMA.h"
-#include "timer.h"
+#include "input.h"
 #include "SDL2/SDL.h"
 #include <stdlib.h>
+#include <string.h>
 
-void clock(void);
+#define STATS_INTERVAL             5000     // ms between idle/emulation time reports
+
+/**** frame pacing ****/
+typedef enum Pacing
+{
+    PACING_AUDIO,      // emulation clocked by the audio callback, main loop sleeps waiting for events
+    PACING_VSYNC,      // one frame emulated per display refresh, main loop blocks on present
+    PACING_WALLCLOCK   // one frame emulated per frame deadline, main loop sleeps until next deadline
+} Pacing;
+
+static struct Stats
+{
+    uint64_t emulating;   // performance counter ticks spent emulating
+    uint64_t idle;        // performance counter ticks spent waiting
+    uint64_t start;       // start of current report interval
+    uint32_t frames;      // frames presented in current report interval
+    uint32_t emulated;    // frames emulated in current report interval
+} stats;
+
+void report_stats(Pacing pacing, int fast_forward);
 
 int main(int argc, char *argv[])
 {
+    Pacing pacing = PACING_AUDIO;
+
+    int turbo = 0;                // fast forward speed multiplier (0: as fast as the host allows)
+    int turbo_mute = 0;           // mute audio in fast forward (otherwise decimated)
+    int always_fast_forward = 0;  // fast forward without holding the fast forward key
+    int audio_latency = 30;       // ms of audio buffered between emulation and audio device
+    int audio_rate = SAMPLING_FREQUENCY;
+    AudioFormat audio_format = AUDIO_FORMAT_S16;
+    const char *input_script_name = NULL;   // replay scripted or recorded input instead of keyboard/game controller
+    const char *record_name = NULL;         // record input for replay
+    BootMode boot_mode = BOOT_MODE_ROM;
+    const char *boot_cache = NULL;          // post-boot snapshots directory
+
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--pacing=audio") == 0)
+            pacing = PACING_AUDIO;
+        else if (strcmp(argv[i], "--pacing=vsync") == 0)
+            pacing = PACING_VSYNC;
+        else if (strcmp(argv[i], "--pacing=wallclock") == 0)
+            pacing = PACING_WALLCLOCK;
+        else if (strncmp(argv[i], "--turbo=", 8) == 0)
+            turbo = atoi(argv[i] + 8);
+        else if (strcmp(argv[i], "--turbo-audio=mute") == 0)
+            turbo_mute = 1;
+        else if (strcmp(argv[i], "--turbo-audio=decimate") == 0)
+            turbo_mute = 0;
+        else if (strcmp(argv[i], "--fast-forward") == 0)
+            always_fast_forward = 1;
+        else if (strncmp(argv[i], "--audio-latency=", 16) == 0)
+            audio_latency = atoi(argv[i] + 16);
+        else if (strcmp(argv[i], "--audio-rate=44100") == 0 || strcmp(argv[i], "--audio-rate=48000") == 0 || strcmp(argv[i], "--audio-rate=96000") == 0)
+            audio_rate = atoi(argv[i] + 13);
+        else if (strcmp(argv[i], "--audio-format=s16") == 0)
+            audio_format = AUDIO_FORMAT_S16;
+        else if (strcmp(argv[i], "--audio-format=f32") == 0)
+            audio_format = AUDIO_FORMAT_F32;
+        else if (strncmp(argv[i], "--input-script=", 15) == 0)
+            input_script_name = argv[i] + 15;
+        else if (strncmp(argv[i], "--record-input=", 15) == 0)
+            record_name = argv[i] + 15;
+        else if (strcmp(argv[i], "--dma=exact") == 0)
+            DMA_set_mode(DMA_MODE_EXACT);
+        else if (strcmp(argv[i], "--dma=fast") == 0)
+            DMA_set_mode(DMA_MODE_FAST);
+        else if (strcmp(argv[i], "--boot=fast") == 0)
+            boot_mode = BOOT_MODE_FAST;
+        else if (strncmp(argv[i], "--boot-cache=", 13) == 0)
+            boot_cache = argv[i] + 13;
+        else
+            printf("unknown option: %s\n", argv[i]);
+
     if (SDL_Init(SDL_INIT_EVENTS) != 0)
     {
         printf("error initializing SDL: %s", SDL_GetError());
@@ -17,83 +89,191 @@ int main(int argc, char *argv[])
     }
   
     /**** CPU test ROMs ****/
-    //cartridge_load("Test ROMs/cpu_instrs/individual/cpu_instrs");                
-    //cartridge_load("Test ROMs/cpu_instrs/individual/01-special");                 // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/02-interrupts");              // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/03-op sp,hl");                // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/04-op r,imm");                // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/05-op rp");                   // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/06-ld r,r");                  // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/07-jr,jp,call,ret,rst");      // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/08-misc instrs");             // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/09-op r,r");                  // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/10-bit ops");                 // OK
-    //cartridge_load("Test ROMs/cpu_instrs/individual/11-op a,(hl)");               // OK
-    //cartridge_load("Test ROMs/instr_timing/instr_timing");                        // OK
-    //cartridge_load("Test ROMs/interrupt_time/interrupt_time");              
-    //cartridge_load("Test ROMs/mem_timing/individual/01-read_timing");
-    //cartridge_load("Test ROMs/mem_timing/individual/02-write_timing");            // OK
-    //cartridge_load("Test ROMs/mem_timing/individual/03-modify_timing");
+    //cartridge_load("Test ROMs/cpu_instrs/individual/cpu_instrs", NULL);                
+    //cartridge_load("Test ROMs/cpu_instrs/individual/01-special", NULL);                 // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/02-interrupts", NULL);              // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/03-op sp,hl", NULL);                // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/04-op r,imm", NULL);                // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/05-op rp", NULL);                   // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/06-ld r,r", NULL);                  // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/07-jr,jp,call,ret,rst", NULL);      // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/08-misc instrs", NULL);             // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/09-op r,r", NULL);                  // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/10-bit ops", NULL);                 // OK
+    //cartridge_load("Test ROMs/cpu_instrs/individual/11-op a,(hl)", NULL);               // OK
+    //cartridge_load("Test ROMs/instr_timing/instr_timing", NULL);                        // OK
+    //cartridge_load("Test ROMs/interrupt_time/interrupt_time", NULL);              
+    //cartridge_load("Test ROMs/mem_timing/individual/01-read_timing", NULL);
+    //cartridge_load("Test ROMs/mem_timing/individual/02-write_timing", NULL);            // OK
+    //cartridge_load("Test ROMs/mem_timing/individual/03-modify_timing", NULL);
 
     /**** APU test ROM ****/
-    //cartridge_load("Test ROMs/dmg_sound/rom_singles/01-registers");
+    //cartridge_load("Test ROMs/dmg_sound/rom_singles/01-registers", NULL);
 
     /**** PPU test ROM ****/
-    //cartridge_load("Test ROMs/PPU/dmg-acid2");   // OK
-
-    //cartridge_load("Tetris");
-    //cartridge_load("Dr. Mario");
-    //cartridge_load("Kirby's Dream Land");
-    //cartridge_load("Super Mario Land");
-    //cartridge_load("DuckTales");
-    //cartridge_load("Tennis");
-    //cartridge_load("Bubble Bobble");
-    //cartridge_load("F-1 Race");    
-    //cartridge_load("Super Mario Land 2 - 6 Golden Coins");
-    //cartridge_load("World Cup 98");
-    cartridge_load("Legend of Zelda, The - Link's Awakening");
+    //cartridge_load("Test ROMs/PPU/dmg-acid2", NULL);   // OK
+
+    //cartridge_load("Tetris", NULL);
+    //cartridge_load("Dr. Mario", NULL);
+    //cartridge_load("Kirby's Dream Land", NULL);
+    //cartridge_load("Super Mario Land", NULL);
+    //cartridge_load("DuckTales", NULL);
+    //cartridge_load("Tennis", NULL);
+    //cartridge_load("Bubble Bobble", NULL);
+    //cartridge_load("F-1 Race", NULL);    
+    //cartridge_load("Super Mario Land 2 - 6 Golden Coins", NULL);
+    //cartridge_load("World Cup 98", NULL);
+    cartridge_load("Legend of Zelda, The - Link's Awakening", NULL);
 
     /**** initialize emulator's systems ****/
-    CPU_init();
-    PPU_init();
-    APU_init();
-    timer_init();
+    Frontend callbacks = frontend_SDL;
+
+    if (input_script_name)
+    {
+        if (!input_script_load(input_script_name))
+            return -1;
+
+        callbacks.input = input_script;
+    }
+
+    if (record_name && !(callbacks.input = input_record(record_name, callbacks.input)))
+        return -1;
+
+    gameboy_set_boot_mode(boot_mode, boot_cache);
+
+    if (!gameboy_init(&callbacks, audio_rate))
+        return -1;
+
+    if (!frontend_SDL_init(pacing == PACING_VSYNC, pacing == PACING_AUDIO, audio_latency, audio_rate, audio_format))   // audio callback starts clocking the emulator right away
+        return -1;
 
     /**** emulation loop ****/
+    const uint64_t ticks_per_second = SDL_GetPerformanceFrequency();
+    const uint64_t frame_ticks = ticks_per_second * FRAME_CYCLES / CLOCK_FREQUENCY;
+    const uint64_t refresh_ticks = ticks_per_second / frontend_SDL_refresh_rate();   // fast forward presents at most once per host refresh
+
+    uint64_t deadline = SDL_GetPerformanceCounter() + frame_ticks;
+    stats.start = SDL_GetPerformanceCounter();
+
+    int fast_forward = 0;
+
     int running = 1;
     while (running)  
     {
         SDL_Event event;
+        uint64_t now = SDL_GetPerformanceCounter();
+
+        frontend_SDL_poll_input();
+
+        int fast_forward_key = always_fast_forward || SDL_GetKeyboardState(NULL)[SDL_SCANCODE_TAB];   // hold TAB to fast forward
+        if (fast_forward_key != fast_forward)
+        {
+            fast_forward = fast_forward_key;
+            frontend_SDL_set_fast_forward(fast_forward, turbo_mute);
+
+            deadline = now + frame_ticks;
+        }
+
+        if (fast_forward)   // emulate several frames per host refresh, only the last one is presented
+        {
+            int frames = 0;
+
+            do
+            {
+                gameboy_run_frame();
+                frames++;
+            } while (turbo ? frames < turbo : SDL_GetPerformanceCounter() - now < refresh_ticks);
+
+            stats.emulated += frames;
+        }
+        else if (pacing == PACING_AUDIO)   // audio callback emulates, wake up once per frame to present
+        {
+            if (SDL_WaitEventTimeout(&event, (int)(frame_ticks * 1000 / ticks_per_second)))
+                if (event.type == SDL_QUIT)
+                    running = 0;
+        }
+        else
+        {
+            gameboy_run_frame();
+            stats.emulated++;
+        }
+
+        if (fast_forward || pacing != PACING_AUDIO)
+        {
+            uint64_t emulated = SDL_GetPerformanceCounter();
+            stats.emulating += emulated - now;
+            now = emulated;
+        }
+
+        if (frontend_SDL_frame_ready())
+        {
+            frontend_SDL_present();   // blocks until next display refresh with vsync pacing
+            stats.frames++;
+        }
+
+        // sleep until next frame deadline, still waking up for events (fixed speed multiplier fast forward sleeps too)
+        if (fast_forward ? turbo && pacing != PACING_VSYNC : pacing == PACING_WALLCLOCK)
+        {
+            uint64_t current;
+
+            while ((current = SDL_GetPerformanceCounter()) < deadline)
+                if (SDL_WaitEventTimeout(&event, (int)((deadline - current) * 1000 / ticks_per_second) + 1))   // round up, never spin
+                    if (event.type == SDL_QUIT)
+                        running = 0;
+
+            deadline += frame_ticks;
+
+            if (current > deadline + frame_ticks * 4)   // fell too far behind, don't try to catch up
+                deadline = current + frame_ticks;
+        }
 
         while (SDL_PollEvent(&event))
             if (event.type == SDL_QUIT)
                 running = 0;
+
+        if (fast_forward || pacing != PACING_AUDIO)
+            stats.idle += SDL_GetPerformanceCounter() - now;
+
+        report_stats(pacing, fast_forward);
     }
     
-    APU_deinit();
-    PPU_deinit();
+    frontend_SDL_deinit();
+    gameboy_deinit();
+    cartridge_unload();
+    input_record_stop();
 
     SDL_Quit();
 
     return 0;
 }
 
-void clock(void)
+void report_stats(Pacing pacing, int fast_forward)
 {
-    if (DMA_active)
-        DMA_copy();
+    uint64_t now = SDL_GetPerformanceCounter();
+    uint64_t elapsed = now - stats.start;
+
+    if (elapsed < SDL_GetPerformanceFrequency() * STATS_INTERVAL / 1000)
+        return;
 
-    CPU_execute_machine_cycle();
+    if (pacing == PACING_AUDIO && !fast_forward)   // emulation runs on the audio thread, everything else is idle time
+    {
+        static uint64_t last_emulation_ticks;
+        uint64_t emulation_ticks = frontend_SDL_emulation_ticks();
+
+        stats.emulating = emulation_ticks - last_emulation_ticks;
+        stats.idle = elapsed > stats.emulating ? elapsed - stats.emulating : 0;
+        stats.emulated = stats.frames;
+        last_emulation_ticks = emulation_ticks;
+    }
 
-    timer_clock();
+    double seconds = (double)elapsed / SDL_GetPerformanceFrequency();
+    double speed = stats.emulated * FRAME_CYCLES / (seconds * CLOCK_FREQUENCY);
 
-    PPU_clock();
-    PPU_clock();
-    PPU_clock();
-    PPU_clock();
+    printf("%.1f fps - %.1fx speed - emulating %.1f%% - idle %.1f%%\n", stats.frames / seconds, speed, 100.0 * stats.emulating / elapsed, 100.0 * stats.idle / elapsed);
 
-    APU_clock();
-    APU_clock();
-    APU_clock();
-    APU_clock();
+    stats.emulating = 0;
+    stats.idle = 0;
+    stats.frames = 0;
+    stats.emulated = 0;
+    stats.start = now;
 }
\ No newline at end of file
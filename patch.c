@@ -0,0 +1,230 @@
+#include "patch.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+// store only bytes that differ: writing an identical byte would still copy the page
+static void patch_byte(uint8_t *target, size_t offset, uint8_t data)
+{
+    if (target[offset] != data)
+        target[offset] = data;
+}
+
+/**** IPS ****/
+// "PATCH", records of 24 bit offset and 16 bit size followed by the data (size 0: 16 bit run length and a byte), "EOF"
+// - the optional truncation length after "EOF" is ignored, ROM banks are sized by the header
+static size_t IPS_apply(const uint8_t *patch, size_t patch_length, size_t source_length, PatchTarget make_target)
+{
+    size_t target_length = source_length;
+
+    for (int pass = 0; pass < 2; pass++)   // first pass validates the records and sizes the patched ROM
+    {
+        uint8_t *target = pass ? make_target(target_length) : NULL;
+        size_t position = 5;
+
+        if (pass && !target)
+            return 0;
+
+        for (;;)
+        {
+            if (position + 3 > patch_length)
+                return 0;
+
+            if (memcmp(patch + position, "EOF", 3) == 0)
+            {
+                position += 3;
+                break;
+            }
+
+            if (position + 5 > patch_length)
+                return 0;
+
+            size_t offset = patch[position] << 16 | patch[position + 1] << 8 | patch[position + 2];
+            size_t size = patch[position + 3] << 8 | patch[position + 4];
+            position += 5;
+
+            if (size)
+            {
+                if (position + size > patch_length)
+                    return 0;
+
+                if (pass)
+                    for (size_t i = 0; i < size; i++)
+                        patch_byte(target, offset + i, patch[position + i]);
+                position += size;
+            }
+            else   // run length encoded record
+            {
+                if (position + 3 > patch_length)
+                    return 0;
+
+                size = patch[position] << 8 | patch[position + 1];
+
+                if (pass)
+                    for (size_t i = 0; i < size; i++)
+                        patch_byte(target, offset + i, patch[position + 2]);
+                position += 3;
+            }
+
+            if (offset + size > target_length)
+                target_length = offset + size;
+        }
+    }
+
+    return target_length;
+}
+
+/**** BPS ****/
+static uint64_t BPS_number(const uint8_t *patch, size_t end, size_t *position)
+{
+    uint64_t number = 0, shift = 1;
+
+    while (*position < end)
+    {
+        uint8_t data = patch[(*position)++];
+
+        number += (data & 0x7F) * shift;
+        if (data & 0x80)
+            break;
+
+        shift <<= 7;
+        number += shift;
+    }
+
+    return number;
+}
+
+// "BPS1", source, target and metadata sizes, actions, then CRC32s of source, target and patch
+static size_t BPS_apply(const uint8_t *patch, size_t patch_length, const uint8_t *source, size_t source_length, PatchTarget make_target)
+{
+    if (patch_length < 4 + 12)
+        return 0;
+
+    size_t end = patch_length - 12;   // actions end where the checksums start
+    uint32_t source_CRC = patch[end] | patch[end + 1] << 8 | patch[end + 2] << 16 | (uint32_t)patch[end + 3] << 24;
+    uint32_t target_CRC = patch[end + 4] | patch[end + 5] << 8 | patch[end + 6] << 16 | (uint32_t)patch[end + 7] << 24;
+    uint32_t patch_CRC = patch[end + 8] | patch[end + 9] << 8 | patch[end + 10] << 16 | (uint32_t)patch[end + 11] << 24;
+
+    if (crc32(0, patch, patch_length - 4) != patch_CRC)
+    {
+        printf("error applying patch: patch checksum mismatch\n");
+        return 0;
+    }
+
+    size_t position = 4;
+    size_t expected_source = BPS_number(patch, end, &position);
+    size_t target_length = BPS_number(patch, end, &position);
+    size_t metadata_length = BPS_number(patch, end, &position);
+    if (metadata_length > end - position)
+        return 0;
+    position += metadata_length;   // skip metadata
+
+    if (expected_source != source_length || crc32(0, source, source_length) != source_CRC)
+    {
+        printf("error applying patch: patch is for a different ROM\n");
+        return 0;
+    }
+
+    uint8_t *target = make_target(target_length);
+    if (!target)
+        return 0;
+
+    size_t output = 0, source_offset = 0, target_offset = 0;
+
+    while (position < end)
+    {
+        uint64_t action = BPS_number(patch, end, &position);
+        size_t length = (action >> 2) + 1;
+
+        if (length > target_length - output)   // sizes come from the patch: compare without wrapping around
+            return 0;
+
+        switch (action & 0x03)
+        {
+            case 0:   // source read: same offset in the source, nothing changes in place
+                if (output > source_length || length > source_length - output)
+                    return 0;
+                for (size_t i = 0; i < length; i++)
+                    patch_byte(target, output + i, source[output + i]);
+                break;
+
+            case 1:   // target read: literal bytes
+                if (length > end - position)
+                    return 0;
+                for (size_t i = 0; i < length; i++)
+                    patch_byte(target, output + i, patch[position++]);
+                break;
+
+            case 2:   // source copy from a relative offset
+            case 3:   // target copy from a relative offset (may overlap the output)
+            {
+                uint64_t data = BPS_number(patch, end, &position);
+                size_t *offset = (action & 0x03) == 2 ? &source_offset : &target_offset;
+
+                uint64_t move = data >> 1;
+
+                if (data & 1 ? move > *offset : move > SIZE_MAX - *offset)   // before the start or past the end of memory
+                    return 0;
+                *offset = data & 1 ? *offset - move : *offset + move;
+
+                if ((action & 0x03) == 2 ? *offset > source_length || length > source_length - *offset : *offset >= output)
+                    return 0;
+
+                for (size_t i = 0; i < length; i++, ++*offset)
+                    patch_byte(target, output + i, (action & 0x03) == 2 ? source[*offset] : target[*offset]);
+                break;
+            }
+        }
+
+        output += length;
+    }
+
+    if (output != target_length || crc32(0, target, target_length) != target_CRC)
+    {
+        printf("error applying patch: patched ROM checksum mismatch\n");
+        return 0;
+    }
+
+    return target_length;
+}
+
+size_t patch_apply(const char *patch_path, const uint8_t *source, size_t source_length, PatchTarget make_target)
+{
+    int file = open(patch_path, O_RDONLY);
+    struct stat patch_stat;
+    if (file == -1 || fstat(file, &patch_stat) == -1 || patch_stat.st_size < 8)
+    {
+        printf("error opening patch: %s\n", patch_path);
+        if (file != -1)
+            close(file);
+        return 0;
+    }
+
+    const uint8_t *patch = (const uint8_t*)mmap(NULL, patch_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (patch == MAP_FAILED)
+    {
+        printf("error mapping patch: %s\n", patch_path);
+        return 0;
+    }
+
+    size_t length = 0;
+
+    if (memcmp(patch, "PATCH", 5) == 0)
+        length = IPS_apply(patch, patch_stat.st_size, source_length, make_target);
+    else if (memcmp(patch, "BPS1", 4) == 0)
+        length = BPS_apply(patch, patch_stat.st_size, source, source_length, make_target);
+    else
+        printf("error applying patch: %s is not an IPS or BPS patch\n", patch_path);
+
+    munmap((void*)patch, patch_stat.st_size);
+
+    if (!length)
+        printf("error applying patch: %s\n", patch_path);
+
+    return length;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef __PATCH_H__
+#define __PATCH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// IPS and BPS ROM patches: the patched ROM is written into a buffer obtained from make_target, already holding
+// the source ROM, and only bytes that change are stored so unchanged copy-on-write pages stay shared
+
+typedef uint8_t *(*PatchTarget)(size_t length);   // writable copy of the source ROM at least length bytes long (NULL: error)
+
+size_t patch_apply(const char *patch_path, const uint8_t *source, size_t source_length, PatchTarget make_target);   // patched ROM length, 0 on error
+
+#endif  // __PATCH_H__
\ No newline at end of file
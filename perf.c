@@ -0,0 +1,88 @@
+#include "perf.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define CACHE_EVENT(cache, op, result)   ((cache) | (op) << 8 | (result) << 16)
+
+static const struct
+{
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} events[PERF_COUNTERS] =
+{
+    [PERF_CYCLES]        = { "cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [PERF_INSTRUCTIONS]  = { "instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [PERF_BRANCH_MISSES] = { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [PERF_L1D_MISSES]    = { "L1D_misses",    PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+    [PERF_LLC_MISSES]    = { "LLC_misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+};
+
+static int fds[PERF_COUNTERS] = { [0 ... PERF_COUNTERS - 1] = -1 };   // perf_read and perf_available run without perf_open too
+
+// counters are opened one by one rather than as a group: a PMU missing one event still provides the others
+int perf_open(void)
+{
+    int available = 0;
+
+    for (int i = 0; i < PERF_COUNTERS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+
+        attr.size = sizeof attr;
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);   // this thread, any CPU
+        if (fds[i] != -1)
+            available++;
+    }
+
+    return available;
+}
+
+void perf_close(void)
+{
+    for (int i = 0; i < PERF_COUNTERS; i++)
+        if (fds[i] != -1)
+        {
+            close(fds[i]);
+            fds[i] = -1;
+        }
+}
+
+int perf_available(PerfCounter counter)
+{
+    return fds[counter] != -1;
+}
+
+const char *perf_name(PerfCounter counter)
+{
+    return events[counter].name;
+}
+
+void perf_read(PerfCounters *counters)
+{
+    for (int i = 0; i < PERF_COUNTERS; i++)
+    {
+        uint64_t data[3];   // value, time enabled, time running
+
+        counters->value[i] = 0;
+        if (fds[i] == -1 || read(fds[i], data, sizeof data) != sizeof data || !data[2])
+            continue;
+
+        counters->value[i] = data[2] < data[1] ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+    }
+}
+
+void perf_elapsed(PerfCounters *counters, const PerfCounters *start)
+{
+    for (int i = 0; i < PERF_COUNTERS; i++)
+        counters->value[i] = counters->value[i] > start->value[i] ? counters->value[i] - start->value[i] : 0;   // scaled estimates may go backwards
+}
\ No newline at end of file
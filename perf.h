@@ -0,0 +1,33 @@
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <stdint.h>
+
+// Linux hardware performance counters (perf_event_open) of the calling thread, user space only - counters the
+// CPU or kernel does not provide (virtual machines, perf_event_paranoid) are reported unavailable
+
+typedef enum PerfCounter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,      // L1 data cache read misses
+    PERF_LLC_MISSES,      // last level cache misses
+    PERF_COUNTERS
+} PerfCounter;
+
+typedef struct PerfCounters
+{
+    uint64_t value[PERF_COUNTERS];
+} PerfCounters;
+
+int perf_open(void);    // number of counters available
+void perf_close(void);
+
+int perf_available(PerfCounter counter);
+const char *perf_name(PerfCounter counter);
+
+void perf_read(PerfCounters *counters);   // running totals, scaled when the kernel multiplexes counters
+void perf_elapsed(PerfCounters *counters, const PerfCounters *start);   // counters - start
+
+#endif  // __PERF_H__
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "rom_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FNV_OFFSET_BASIS     0xCBF29CE484222325ull
+#define FNV_PRIME            0x00000100000001B3ull
+
+uint64_t rom_hash(const uint8_t *ROM, size_t length)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ ROM[i]) * FNV_PRIME;
+
+    return hash;
+}
+
+/**** scanning ****/
+int rom_index_scan_file(const char *path, RomIndexEntry *entry)
+{
+    int rom = open(path, O_RDONLY);
+    struct stat rom_stat;
+    if (rom == -1 || fstat(rom, &rom_stat) == -1 || rom_stat.st_size < 0x150 || rom_stat.st_size > UINT32_MAX)
+    {
+        printf("error reading ROM: %s\n", path);
+        if (rom != -1)
+            close(rom);
+        return 0;
+    }
+
+    const uint8_t *ROM = (const uint8_t*)mmap(NULL, rom_stat.st_size, PROT_READ, MAP_PRIVATE, rom, 0);
+    close(rom);
+    if (ROM == MAP_FAILED)
+    {
+        printf("error mapping ROM: %s\n", path);
+        return 0;
+    }
+    madvise((void*)ROM, rom_stat.st_size, MADV_SEQUENTIAL);
+
+    memset(entry, 0, sizeof *entry);
+    entry->length = rom_stat.st_size;
+
+    // cartridge header 0x0134 - 0x014F, read the same way cartridge_load does
+    const uint8_t *header = ROM + 0x134;
+    memcpy(entry->title, header, 16);
+    if (header[0x0F] & 0x80)   // 0x0143 is the CGB flag on color compatible cartridges: the title is 15 bytes
+        entry->title[15] = '\0';
+    entry->type = header[0x13];
+    entry->ROM_size = header[0x14];
+    entry->RAM_size = header[0x15];
+    entry->header_checksum = header[0x19];
+    entry->global_checksum = header[0x1A] << 8 | header[0x1B];   // big endian
+
+    uint8_t header_checksum = 0;
+    for (int i = 0x134; i <= 0x14C; i++)
+        header_checksum = header_checksum - ROM[i] - 1;
+
+    uint16_t global_checksum = 0;
+    for (size_t i = 0; i < entry->length; i++)
+        global_checksum += ROM[i];
+    global_checksum -= ROM[0x14E] + ROM[0x14F];   // the checksum bytes themselves are excluded
+
+    entry->flags = (header_checksum == entry->header_checksum ? ROM_INDEX_HEADER_OK : 0) |
+                   (global_checksum == entry->global_checksum ? ROM_INDEX_GLOBAL_OK : 0);
+    entry->hash = rom_hash(ROM, entry->length);
+
+    munmap((void*)ROM, rom_stat.st_size);
+
+    return 1;
+}
+
+/**** index file ****/
+static int compare_entries(const void *a, const void *b)
+{
+    uint64_t hash_a = ((const RomIndexEntry*)a)->hash, hash_b = ((const RomIndexEntry*)b)->hash;
+
+    return hash_a < hash_b ? -1 : hash_a > hash_b;
+}
+
+int rom_index_write(const char *file_name, RomIndexEntry *entries, const char **paths, uint32_t count)
+{
+    RomIndexHeader header = { ROM_INDEX_MAGIC, ROM_INDEX_VERSION, count, 0 };
+
+    qsort(entries, count, sizeof *entries, compare_entries);
+
+    // the string table holds the paths in entry order, path members become string table offsets
+    const char **strings = (const char**)malloc(count * sizeof *strings + 1);
+    if (!strings)
+    {
+        printf("error creating index: %s\n", file_name);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        strings[i] = paths[entries[i].path];
+        entries[i].path = header.strings_size;
+        header.strings_size += strlen(strings[i]) + 1;
+    }
+
+    FILE *file = fopen(file_name, "wb");
+    if (!file)
+    {
+        printf("error creating index: %s\n", file_name);
+        free(strings);
+        return 0;
+    }
+
+    fwrite(&header, sizeof header, 1, file);
+    fwrite(entries, sizeof *entries, count, file);
+    for (uint32_t i = 0; i < count; i++)
+        fwrite(strings[i], strlen(strings[i]) + 1, 1, file);
+
+    free(strings);
+
+    int failed = ferror(file);
+    failed |= fclose(file) != 0;
+    if (failed)
+    {
+        printf("error writing index: %s\n", file_name);
+        return 0;
+    }
+
+    return 1;
+}
+
+// the index is mapped read-only: opening a game by hash or title touches no other file
+int rom_index_open(RomIndex *index, const char *file_name)
+{
+    int file = open(file_name, O_RDONLY);
+    struct stat file_stat;
+    if (file == -1 || fstat(file, &file_stat) == -1 || file_stat.st_size < sizeof(RomIndexHeader))
+    {
+        printf("error opening index: %s\n", file_name);
+        if (file != -1)
+            close(file);
+        return 0;
+    }
+
+    void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+    {
+        printf("error mapping index: %s\n", file_name);
+        return 0;
+    }
+
+    index->header = (const RomIndexHeader*)data;
+    index->entries = (const RomIndexEntry*)(index->header + 1);
+    index->strings = (const char*)(index->entries + index->header->count);
+    index->length = file_stat.st_size;
+
+    if (index->header->magic != ROM_INDEX_MAGIC || index->header->version != ROM_INDEX_VERSION ||
+        sizeof(RomIndexHeader) + (size_t)index->header->count * sizeof(RomIndexEntry) + index->header->strings_size != index->length)
+    {
+        printf("error opening index: %s is not a ROM index\n", file_name);
+        rom_index_close(index);
+        return 0;
+    }
+
+    // every path must be a NUL terminated string inside the table: rom_index_path returns them unchecked
+    uint32_t strings_size = index->header->strings_size;
+    int valid = strings_size == 0 ? index->header->count == 0 : index->strings[strings_size - 1] == '\0';
+    for (uint32_t i = 0; valid && i < index->header->count; i++)
+        valid = index->entries[i].path < strings_size;
+
+    if (!valid)
+    {
+        printf("error opening index: %s has a corrupt string table\n", file_name);
+        rom_index_close(index);
+        return 0;
+    }
+
+    return 1;
+}
+
+void rom_index_close(RomIndex *index)
+{
+    if (index->header)
+        munmap((void*)index->header, index->length);
+
+    index->header = NULL;
+}
+
+/**** lookup ****/
+const RomIndexEntry *rom_index_find_hash(const RomIndex *index, uint64_t hash)
+{
+    uint32_t low = 0, high = index->header->count;
+
+    while (low < high)   // binary search of the entries sorted by hash
+    {
+        uint32_t middle = low + (high - low) / 2;
+
+        if (index->entries[middle].hash < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low < index->header->count && index->entries[low].hash == hash ? &index->entries[low] : NULL;
+}
+
+const RomIndexEntry *rom_index_find_title(const RomIndex *index, const char *title)
+{
+    for (uint32_t i = 0; i < index->header->count; i++)
+        if (strncmp(index->entries[i].title, title, sizeof index->entries[i].title) == 0 && strlen(title) <= sizeof index->entries[i].title)
+            return &index->entries[i];
+
+    return NULL;
+}
+
+const RomIndexEntry *rom_index_find(const RomIndex *index, const char *key)
+{
+    char *end;
+
+    if (strlen(key) == 16)
+    {
+        uint64_t hash = strtoull(key, &end, 16);
+
+        if (*end == '\0')
+            return rom_index_find_hash(index, hash);
+    }
+
+    return rom_index_find_title(index, key);
+}
+
+const char *rom_index_path(const RomIndex *index, const RomIndexEntry *entry)
+{
+    return index->strings + entry->path;
+}
\ No newline at end of file
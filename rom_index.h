@@ -0,0 +1,59 @@
+#ifndef __ROM_INDEX_H__
+#define __ROM_INDEX_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ROM library index: cartridge headers, checksums and hashes of a set of ROM files scanned once,
+// stored sorted by hash in a binary file that is mapped read-only to find a game by hash or title
+
+#define ROM_INDEX_MAGIC          0x58494247   // "GBIX"
+#define ROM_INDEX_VERSION        2
+
+#define ROM_INDEX_HEADER_OK      0x01         // header checksum (0x014D) matches
+#define ROM_INDEX_GLOBAL_OK      0x02         // global checksum (0x014E - 0x014F) matches
+
+typedef struct RomIndexEntry
+{
+    uint64_t hash;              // FNV-1a 64 of the whole ROM file
+    uint32_t length;            // ROM file size
+    uint32_t path;              // offset of the NUL terminated path in the string table
+    char title[16];             // 0x0134 - 0x0143 (0x0142 on CGB compatible cartridges), NUL padded
+    uint8_t type;               // 0x0147 cartridge type
+    uint8_t ROM_size;           // 0x0148
+    uint8_t RAM_size;           // 0x0149
+    uint8_t flags;
+    uint16_t global_checksum;
+    uint8_t header_checksum;
+    uint8_t reserved;
+} RomIndexEntry;
+
+typedef struct RomIndexHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;             // entries following the header
+    uint32_t strings_size;      // string table following the entries
+} RomIndexHeader;
+
+typedef struct RomIndex
+{
+    const RomIndexHeader *header;
+    const RomIndexEntry *entries;
+    const char *strings;
+    size_t length;
+} RomIndex;
+
+uint64_t rom_hash(const uint8_t *ROM, size_t length);   // FNV-1a 64
+int rom_index_scan_file(const char *path, RomIndexEntry *entry);   // fills everything but path
+int rom_index_write(const char *file_name, RomIndexEntry *entries, const char **paths, uint32_t count);   // entry path members index paths, sorts entries
+
+int rom_index_open(RomIndex *index, const char *file_name);
+void rom_index_close(RomIndex *index);
+
+const RomIndexEntry *rom_index_find_hash(const RomIndex *index, uint64_t hash);
+const RomIndexEntry *rom_index_find_title(const RomIndex *index, const char *title);
+const RomIndexEntry *rom_index_find(const RomIndex *index, const char *key);   // 16 hex digit hash or title
+const char *rom_index_path(const RomIndex *index, const RomIndexEntry *entry);
+
+#endif  // __ROM_INDEX_H__
\ No newline at end of file
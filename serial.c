@@ -1,14 +1,86 @@
 #include "serial.h"
-#include <stdio.h>
+#include "bus.h"
+#include "gameboy.h"
+#include "link.h"
+#include "frontend.h"
+
+#define SC_TRANSFER_START      0x80
+#define SC_INTERNAL_CLOCK      0x01
+#define SC_UNUSED_BITS         0x7E    // read as 1
+
+#define SERIAL_BIT_CYCLES       512    // internal clock 8192 Hz
+#define SERIAL_BYTE_CYCLES     (SERIAL_BIT_CYCLES * 8)
 
 typedef struct Serial
 {
     uint8_t SB;    // serial transfer data (R/W)    - 0xFF01
     uint8_t SC;    // serial transfer control (R/W) - 0xFF02
+
+    uint64_t transfer_end;   // clock cycle the byte clocked by the internal clock is shifted out (UINT64_MAX: no transfer)
 } Serial;
 
 Serial serial;
 
+uint64_t serial_next_event = UINT64_MAX;
+
+static void serial_schedule(void)
+{
+    serial_next_event = serial.transfer_end < link_sync_time ? serial.transfer_end : link_sync_time;
+}
+
+static void serial_complete(uint8_t data)
+{
+    serial.SB = data;
+    serial.SC &= ~SC_TRANSFER_START;
+
+    set_int_flag(INT_SERIAL);
+}
+
+void serial_state(State *state)
+{
+    state_io(state, &serial, sizeof serial);
+
+    if (state->loading)
+        serial_schedule();   // the link cable sync point belongs to the instance
+}
+
+void serial_init(void)
+{
+    serial.SB = 0x00;
+    serial.SC = SC_UNUSED_BITS;
+    serial.transfer_end = UINT64_MAX;
+
+    serial_schedule();
+}
+
+// called when clock_cycles reaches serial_next_event
+void serial_clock(void)
+{
+    if (clock_cycles >= link_sync_time)
+        link_sync();
+
+    if (clock_cycles >= serial.transfer_end)
+    {
+        serial.transfer_end = UINT64_MAX;
+
+        serial_complete(link_connected() ? link_wait_reply() : 0xFF);   // no peer: 1s are shifted in
+    }
+
+    serial_schedule();
+}
+
+// peer clocked a byte in with its internal clock - returns the byte shifted out
+uint8_t serial_external_transfer(uint8_t data)
+{
+    if ((serial.SC & (SC_TRANSFER_START | SC_INTERNAL_CLOCK)) != SC_TRANSFER_START)   // not waiting for an external clock
+        return 0xFF;
+
+    uint8_t out = serial.SB;
+    serial_complete(data);
+
+    return out;
+}
+
 void serial_write_SB(uint8_t data)
 {
     serial.SB = data;
@@ -16,10 +88,22 @@ void serial_write_SB(uint8_t data)
 
 void serial_write_SC(uint8_t data)
 {
-    serial.SC = data;
+    serial.SC = data | SC_UNUSED_BITS;
+
+    if ((data & (SC_TRANSFER_START | SC_INTERNAL_CLOCK)) == (SC_TRANSFER_START | SC_INTERNAL_CLOCK))
+    {
+        serial.transfer_end = clock_cycles + SERIAL_BYTE_CYCLES;
+
+        if (frontend.serial_byte)   // test ROMs print their results through the serial port
+            frontend.serial_byte(serial.SB);
+
+        if (link_connected())
+            link_transfer(serial.SB);
+    }
+    else
+        serial.transfer_end = UINT64_MAX;   // external clock: transfer completes when the peer clocks it
 
-    //if (data & 0x81)
-    //    printf("%c", serial.SB);  // debug test ROM - print to console
+    serial_schedule();
 }
 
 uint8_t serial_read_SB(void)
@@ -2,6 +2,14 @@
 #define __SERIAL_H__
 
 #include <stdint.h>
+#include "state.h"
+
+extern uint64_t serial_next_event;   // clock cycle serial_clock must be called at
+
+void serial_init(void);
+void serial_clock(void);
+void serial_state(State *state);
+uint8_t serial_external_transfer(uint8_t data);
 
 void serial_write_SB(uint8_t data);
 void serial_write_SC(uint8_t data);
@@ -0,0 +1,12 @@
+#include "state.h"
+#include <string.h>
+
+void state_io(State *state, void *block, size_t size)
+{
+    if (state->data && state->loading)
+        memcpy(block, state->data + state->size, size);
+    else if (state->data)
+        memcpy(state->data + state->size, block, size);
+
+    state->size += size;
+}
\ No newline at end of file
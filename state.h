@@ -0,0 +1,20 @@
+#ifndef __STATE_H__
+#define __STATE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// machine state snapshot: each module copies its state blocks out of or into one flat buffer in a fixed order,
+// so the same function both saves and loads (pointers are stored as indices)
+
+typedef struct State
+{
+    uint8_t *data;     // NULL: only count the snapshot size
+    size_t size;       // bytes saved or loaded so far
+    int loading;
+    int boot;          // post-boot snapshot, shared by every save of the ROM: per-save state is left out
+} State;
+
+void state_io(State *state, void *block, size_t size);
+
+#endif  // __STATE_H__
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include "gameboy.h"
+#include "cartridge.h"
+#include "CPU.h"
+#include "bus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// headless test ROM runner: each ROM runs in its own process (the emulation core is a single instance per process),
+// up to -j at a time, until it reports a verdict or its cycle budget runs out
+
+#define SERIAL_CAPTURE_SIZE        4096
+#define CHECK_CYCLES              (FRAME_CYCLES * 10)   // emulated between verdict checks
+#define DEFAULT_BUDGET              30                  // seconds of emulated time
+
+typedef enum Verdict { VERDICT_PASSED, VERDICT_FAILED, VERDICT_TIMEOUT, VERDICT_ERROR, VERDICT_NONE } Verdict;
+
+static const char *verdict_names[] = { "PASSED", "FAILED", "TIMEOUT", "ERROR" };
+
+typedef struct TestROM
+{
+    const char *name;
+    uint32_t budget;   // seconds of emulated time
+} TestROM;
+
+static const TestROM default_tests[] =
+{
+    { "Test ROMs/cpu_instrs/individual/01-special",             10 },
+    { "Test ROMs/cpu_instrs/individual/02-interrupts",           5 },
+    { "Test ROMs/cpu_instrs/individual/03-op sp,hl",            10 },
+    { "Test ROMs/cpu_instrs/individual/04-op r,imm",            10 },
+    { "Test ROMs/cpu_instrs/individual/05-op rp",               10 },
+    { "Test ROMs/cpu_instrs/individual/06-ld r,r",               5 },
+    { "Test ROMs/cpu_instrs/individual/07-jr,jp,call,ret,rst",   5 },
+    { "Test ROMs/cpu_instrs/individual/08-misc instrs",          5 },
+    { "Test ROMs/cpu_instrs/individual/09-op r,r",              15 },
+    { "Test ROMs/cpu_instrs/individual/10-bit ops",             20 },
+    { "Test ROMs/cpu_instrs/individual/11-op a,(hl)",           25 },
+    { "Test ROMs/instr_timing/instr_timing",                     5 },
+    { "Test ROMs/interrupt_time/interrupt_time",                 5 },
+    { "Test ROMs/mem_timing/individual/01-read_timing",          5 },
+    { "Test ROMs/mem_timing/individual/02-write_timing",         5 },
+    { "Test ROMs/mem_timing/individual/03-modify_timing",        5 },
+    { "Test ROMs/dmg_sound/rom_singles/01-registers",           10 },
+};
+
+/**** single test run (child process) ****/
+static char serial_output[SERIAL_CAPTURE_SIZE + 1];
+static int serial_length;
+static Verdict verdict = VERDICT_NONE;
+
+static void serial_byte(uint8_t data)
+{
+    if (serial_length < SERIAL_CAPTURE_SIZE)
+        serial_output[serial_length++] = data;
+
+    if (strstr(serial_output, "Passed"))
+        verdict = VERDICT_PASSED;
+    else if (strstr(serial_output, "Failed"))
+        verdict = VERDICT_FAILED;
+}
+
+// mooneye test ROMs execute LD B,B when done, with fibonacci numbers in the registers on success
+static void breakpoint(void)
+{
+    if (cpu.B == 3 && cpu.C == 5 && cpu.D == 8 && cpu.E == 13 && cpu.H == 21 && cpu.L == 34)
+        verdict = VERDICT_PASSED;
+    else if (cpu.B == 0x42 && cpu.C == 0x42 && cpu.D == 0x42 && cpu.E == 0x42 && cpu.H == 0x42 && cpu.L == 0x42)
+        verdict = VERDICT_FAILED;
+}
+
+// blargg test ROMs also report through cartridge RAM: signature DE B0 61 at 0xA001, result at 0xA000 (0x80 while running)
+static void check_memory_signature(void)
+{
+    if (bus_read(0xA001) == 0xDE && bus_read(0xA002) == 0xB0 && bus_read(0xA003) == 0x61)
+    {
+        uint8_t result = bus_read(0xA000);
+
+        if (result != 0x80)
+            verdict = result == 0x00 ? VERDICT_PASSED : VERDICT_FAILED;
+    }
+}
+
+static const Frontend frontend_test = { NULL, NULL, NULL, NULL, serial_byte, breakpoint };
+
+static Verdict run_test(const char *rom_name, uint32_t budget)
+{
+    if (!cartridge_load(rom_name, NULL) || !gameboy_init(&frontend_test, 0))   // audio disabled
+        return VERDICT_ERROR;
+
+    for (uint64_t cycles = 0; verdict == VERDICT_NONE && cycles < (uint64_t)budget * CLOCK_FREQUENCY; cycles += CHECK_CYCLES)
+    {
+        gameboy_run_cycles(CHECK_CYCLES);
+        check_memory_signature();
+    }
+
+    gameboy_deinit();
+    cartridge_unload();
+
+    return verdict == VERDICT_NONE ? VERDICT_TIMEOUT : verdict;
+}
+
+/**** parallel runner ****/
+typedef struct Job
+{
+    pid_t pid;
+    int pipe;           // child's serial output
+    Verdict verdict;
+    char output[SERIAL_CAPTURE_SIZE + 1];
+} Job;
+
+static void print_result(const TestROM *test, const Job *job, int verbose)
+{
+    printf("%-8s %s\n", verdict_names[job->verdict], test->name);
+
+    if (verbose || job->verdict != VERDICT_PASSED)
+        printf("%s\n", job->output);
+}
+
+// child exited: read its serial output (small enough to sit in the pipe buffer) and its verdict
+static void collect(Job *job, int status)
+{
+    int length = 0;
+    ssize_t result;
+
+    while (length < SERIAL_CAPTURE_SIZE && (result = read(job->pipe, job->output + length, SERIAL_CAPTURE_SIZE - length)) > 0)
+        length += result;
+
+    job->output[length] = '\0';
+    close(job->pipe);
+
+    job->verdict = WIFEXITED(status) && WEXITSTATUS(status) <= VERDICT_ERROR ? WEXITSTATUS(status) : VERDICT_ERROR;
+}
+
+int main(int argc, char *argv[])
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t budget = DEFAULT_BUDGET;
+    int verbose = 0;
+    BootMode boot_mode = BOOT_MODE_ROM;
+    const char *boot_cache = NULL;   // post-boot snapshots directory, shared by all jobs
+
+    TestROM *tests = malloc(sizeof(TestROM) * argc);
+    int test_count = 0;
+
+    for (int i = 1; i < argc; i++)
+        if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            if (!argv[i][2] && i + 1 == argc)   // -j without a count
+            {
+                printf("usage: %s [-j N] [--budget=seconds] [-v] [--boot=fast | --boot-cache=dir] [ROM names]\n", argv[0]);
+                free(tests);
+                return -1;
+            }
+            jobs = strtol(argv[i][2] ? argv[i] + 2 : argv[++i], NULL, 10);
+        }
+        else if (strncmp(argv[i], "--budget=", 9) == 0)
+            budget = strtoul(argv[i] + 9, NULL, 10);
+        else if (strcmp(argv[i], "-v") == 0)
+            verbose = 1;
+        else if (strcmp(argv[i], "--boot=fast") == 0)
+            boot_mode = BOOT_MODE_FAST;
+        else if (strncmp(argv[i], "--boot-cache=", 13) == 0)
+            boot_cache = argv[i] + 13;
+        else if (argv[i][0] != '-')
+            tests[test_count++] = (TestROM){ argv[i], 0 };
+        else
+            printf("unknown option: %s\n", argv[i]);
+
+    if (!test_count)   // no ROMs given: run the default list with its own budgets
+    {
+        free(tests);
+        tests = (TestROM*)default_tests;
+        test_count = sizeof default_tests / sizeof default_tests[0];
+    }
+    else
+        for (int i = 0; i < test_count; i++)
+            tests[i].budget = budget;
+
+    if (jobs < 1)
+        jobs = 1;
+
+    gameboy_set_boot_mode(boot_mode, boot_cache);   // inherited by the job processes
+
+    Job *results = calloc(test_count, sizeof(Job));
+    int started = 0, finished = 0, running = 0, failures = 0;
+
+    fflush(stdout);
+
+    while (finished < test_count)
+    {
+        while (running < jobs && started < test_count)
+        {
+            int fds[2];
+            Job *job = &results[started];
+
+            if (pipe(fds) < 0 || (job->pid = fork()) < 0)
+            {
+                printf("error starting test\n");
+                return -1;
+            }
+
+            if (job->pid == 0)   // child: run the ROM, serial output goes back through the pipe
+            {
+                close(fds[0]);
+
+                freopen("/dev/null", "w", stdout);   // keep core error messages out of the report
+                Verdict result = run_test(tests[started].name, tests[started].budget);
+
+                write(fds[1], serial_output, serial_length);
+                _exit(result);
+            }
+
+            close(fds[1]);
+            job->pipe = fds[0];
+
+            started++;
+            running++;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+
+        for (int i = 0; i < started; i++)
+            if (results[i].pid == pid)
+            {
+                collect(&results[i], status);
+
+                finished++;
+                running--;
+            }
+    }
+
+    for (int i = 0; i < test_count; i++)
+    {
+        print_result(&tests[i], &results[i], verbose);
+
+        if (results[i].verdict != VERDICT_PASSED)
+            failures++;
+    }
+
+    printf("%d/%d passed\n", test_count - failures, test_count);
+
+    return failures ? 1 : 0;
+}
\ No newline at end of file
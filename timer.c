@@ -1,91 +1,132 @@
 #include "timer.h"
 #include "bus.h"
+#include "APU.h"
+#include "gameboy.h"
 
 #define TIMER_ENABLE_BIT         0x04
 #define TIMER_FREQUENCY_BITS     0x03
+#define DIV_APU_BIT            0x1000    // APU frame sequencer clocked on falling edge of DIV bit 12 (512 Hz)
+#define DIV_APU_PERIOD         0x2000
 
 uint16_t frequencies[] = { 1024, 16, 64, 256 };
 
 typedef struct Timer Timer;
 
+// the timer is not clocked every machine cycle: DIV and TIMA are computed from clock_cycles when read or written,
+// and timer_clock only runs for scheduled events (TIMA overflow reload, APU frame sequencer clock)
 struct Timer
 {
-	uint16_t DIV;  // divide register (R/W) - 0xFF04
-	uint8_t TIMA;  // timer counter (R/W)   - 0xFF05
-	uint8_t TMA;   // timer modulo (R/W)    - 0xFF06
-	uint8_t TAC;   // timer control (R/W)   - 0xFF07
+	uint64_t DIV_base;        // clock cycle the 16-bit divider (DIV is its upper byte) was 0 - divider = clock_cycles - DIV_base
+	uint8_t TIMA;             // timer counter (R/W)   - 0xFF05 - value at TIMA_time
+	uint8_t TMA;              // timer modulo (R/W)    - 0xFF06
+	uint8_t TAC;              // timer control (R/W)   - 0xFF07
 
-	int overflow;
+	uint64_t TIMA_time;       // clock cycle TIMA was last brought up to date
+	uint64_t overflow_time;   // clock cycle TIMA is reloaded from TMA and the interrupt requested (UINT64_MAX: not scheduled)
+	uint64_t APU_time;        // clock cycle of the next falling edge of DIV bit 12
+
+	int overflow;             // TIMA overflowed, reload pending
 };
 
 Timer timer;
 
+uint64_t timer_next_event;
+
+static uint16_t timer_divider(void)
+{
+	return (uint16_t)(clock_cycles - timer.DIV_base);
+}
+
+// bring TIMA up to date: TIMA is increased on falling edges of the divider bit selected by TAC
+static void timer_sync(void)
+{
+	if (timer.TAC & TIMER_ENABLE_BIT && !timer.overflow)
+	{
+		uint16_t period = frequencies[timer.TAC & TIMER_FREQUENCY_BITS];
+		uint64_t edges = (clock_cycles - timer.DIV_base) / period - (timer.TIMA_time - timer.DIV_base) / period;
+
+		if (edges > 0xFF - timer.TIMA)   // overflowed during the last machine cycle, reload is due next machine cycle
+		{
+			timer.TIMA = 0x00;
+			timer.overflow = 1;
+		}
+		else
+			timer.TIMA += edges;
+	}
+
+	timer.TIMA_time = clock_cycles;
+}
+
+static void timer_schedule(void)
+{
+	if (!(timer.TAC & TIMER_ENABLE_BIT))
+		timer.overflow_time = UINT64_MAX;
+	else if (timer.overflow)
+	{
+		if (timer.overflow_time == UINT64_MAX)   // reload was held while timer was disabled
+			timer.overflow_time = clock_cycles + 4;
+	}
+	else
+	{
+		uint16_t period = frequencies[timer.TAC & TIMER_FREQUENCY_BITS];
+
+		timer.overflow_time = timer.DIV_base + ((timer.TIMA_time - timer.DIV_base) / period + 0x100 - timer.TIMA) * period + 4;
+	}
+
+	timer_next_event = timer.overflow_time < timer.APU_time ? timer.overflow_time : timer.APU_time;
+}
+
 void timer_init(void)
 {
-	timer.DIV = 0xABCC;
+	timer.DIV_base = clock_cycles - 0xABCC;
 	timer.TIMA = 0x00;
 	timer.TMA = 0x00;
 	timer.TAC = 0x00;
 
+	timer.TIMA_time = clock_cycles;
+	timer.APU_time = timer.DIV_base + ((clock_cycles - timer.DIV_base) / DIV_APU_PERIOD + 1) * DIV_APU_PERIOD;
 	timer.overflow = 0;
+
+	timer_schedule();
+}
+
+void timer_state(State *state)
+{
+	state_io(state, &timer, sizeof timer);
+
+	if (state->loading)
+		timer_schedule();
 }
 
+// called when clock_cycles reaches timer_next_event
 void timer_clock(void)
 {
-	//uint16_t old_DIV = timer.DIV;
-	//timer.DIV += 4;  // timer is clocked every clock cycles (4.194304 MHz) but function called every machine cycle (1.048576 MHz) - DIV is always counting even if timer is disabled
-
-	//if (timer.TAC & TIMER_ENABLE_BIT)  // if timer is enabled increase TIMA
-	//{
-	//	switch (timer.TAC & TIMER_FREQUENCY_BITS)  // timer frequency
-	//	{
-	//		case 0:
-	//			if (old_DIV & 1 << 9 && !(timer.DIV & 1 << 9))   // increased every 1024 clock cycles / 256 machine cycles
-	//				timer.TIMA++;
-	//			break;
-	//		case 1:
-	//			if (old_DIV & 1 << 3 && !(timer.DIV & 1 << 3))   // increased every 16 clock cycles / 4 machine cycles
-	//				timer.TIMA++;
-	//			break;
-	//		case 2:
-	//			if (old_DIV & 1 << 5 && !(timer.DIV & 1 << 5))   // increased every 64 clock cycles / 16 machine cycles
-	//				timer.TIMA++;
-	//			break;
-	//		case 3:
-	//			if (old_DIV & 1 << 7 && !(timer.DIV & 1 << 7))   // increased every 256 clock cycles / 64 machine cycles
-	//				timer.TIMA++;
-	//			break;
-	//	}
-	//	
-	//	if (timer.TIMA == 0x00)  // timer overflow
-	//		;
-	//}
-
-	uint16_t old_DIV = timer.DIV;
-	timer.DIV += 4;    // timer is clocked every clock cycles (4.194304 MHz) but function called every machine cycle (1.048576 MHz) - DIV is always counting even if timer is disabled
-
-	if (timer.TAC & TIMER_ENABLE_BIT)  // if timer is enabled increase TIMA
+	if (clock_cycles >= timer.APU_time)
 	{
-		if (timer.overflow)
-		{
-			timer.TIMA = timer.TMA;     // reload timer 
-			set_int_flag(INT_TIMER);    // set interrupt flag
+		APU_frame_sequencer_clock();
+		timer.APU_time += DIV_APU_PERIOD;
+	}
 
-			timer.overflow = 0;
-		}
-		else if (old_DIV & frequencies[timer.TAC & TIMER_FREQUENCY_BITS] >> 1 && !(timer.DIV & frequencies[timer.TAC & TIMER_FREQUENCY_BITS] >> 1))
-		{
-			timer.TIMA++;
+	if (clock_cycles >= timer.overflow_time)
+	{
+		timer_sync();
 
-			if (timer.TIMA == 0x00)
-				timer.overflow = 1;
-		}
+		timer.TIMA = timer.TMA;     // reload timer 
+		set_int_flag(INT_TIMER);    // set interrupt flag
+
+		timer.overflow = 0;
+		timer.overflow_time = UINT64_MAX;
 	}
+
+	timer_schedule();
 }
 
 void timer_write_TIMA(uint8_t value)
 {
+	timer_sync();
 	timer.TIMA = value;
+
+	timer_schedule();
 }
 
 void timer_write_TMA(uint8_t value)
@@ -97,29 +138,47 @@ void timer_write_DIV(uint8_t data)
 {
 	(void)data;
 
-	if (timer.TAC & TIMER_ENABLE_BIT && timer.DIV & frequencies[timer.TAC & TIMER_FREQUENCY_BITS] >> 1)
+	timer_sync();
+
+	uint16_t divider = timer_divider();
+
+	if (timer.TAC & TIMER_ENABLE_BIT && divider & frequencies[timer.TAC & TIMER_FREQUENCY_BITS] >> 1)
 		timer.TIMA++;
 
-	timer.DIV = 0x0000;  // writing to DIV resets the counter
+	if (divider & DIV_APU_BIT)   // resetting DIV can clock the frame sequencer too
+		APU_frame_sequencer_clock();
+
+	timer.DIV_base = clock_cycles;  // writing to DIV resets the counter
+	timer.APU_time = clock_cycles + DIV_APU_PERIOD;
+
+	timer_schedule();
 }
 
 void timer_write_TAC(uint8_t value)
 {
+	timer_sync();
+
+	uint16_t divider = timer_divider();
+
 	if (timer.TAC & TIMER_ENABLE_BIT)     // timer is enabled
 		if (!(value & TIMER_ENABLE_BIT))   // disable timer
 		{
-			if (timer.DIV & frequencies[timer.TAC & TIMER_FREQUENCY_BITS] >> 1)
+			if (divider & frequencies[timer.TAC & TIMER_FREQUENCY_BITS] >> 1)
 				timer.TIMA++;
 		}
 		else                               // enable timer
-			if (timer.DIV & frequencies[timer.TAC & TIMER_FREQUENCY_BITS] >> 1 && !(timer.DIV & frequencies[value & TIMER_FREQUENCY_BITS] >> 1))
+			if (divider & frequencies[timer.TAC & TIMER_FREQUENCY_BITS] >> 1 && !(divider & frequencies[value & TIMER_FREQUENCY_BITS] >> 1))
 				timer.TIMA++;
 
 	timer.TAC = value & 0x07;
+
+	timer_schedule();
 }
 
 uint8_t timer_read_TIMA(void)
 {
+	timer_sync();
+
 	return timer.TIMA;
 }
 
@@ -130,7 +189,7 @@ uint8_t timer_read_TMA(void)
 
 uint8_t timer_read_DIV(void)
 {
-	return timer.DIV >> 8;
+	return timer_divider() >> 8;
 }
 
 uint8_t timer_read_TAC(void)
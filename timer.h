@@ -2,9 +2,13 @@
 #define __TIMER_H__
 
 #include <stdint.h>
+#include "state.h"
+
+extern uint64_t timer_next_event;   // clock cycle timer_clock must be called at
 
 void timer_init(void);
 void timer_clock(void); 
+void timer_state(State *state);
 void timer_write_TIMA(uint8_t value);
 void timer_write_TMA(uint8_t value);
 void timer_write_DIV(uint8_t data);
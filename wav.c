@@ -0,0 +1,78 @@
+#include "wav.h"
+
+#define WAV_HEADER_SIZE                     44
+#define WAV_BUFFER_SIZE              (1 << 20)   // bytes buffered between writes to the file
+
+static void put_16(uint8_t *p, uint16_t value)
+{
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static void put_32(uint8_t *p, uint32_t value)
+{
+    put_16(p, value & 0xFFFF);
+    put_16(p + 2, value >> 16);
+}
+
+static void write_header(WavWriter *wav, uint32_t sampling_frequency)
+{
+    uint8_t header[WAV_HEADER_SIZE] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' };
+
+    put_32(header + 4, WAV_HEADER_SIZE - 8 + wav->data_size);   // RIFF chunk size
+    put_32(header + 16, 16);                                     // fmt chunk size
+    put_16(header + 20, 1);                                      // PCM
+    put_16(header + 22, wav->channels);
+    put_32(header + 24, sampling_frequency);
+    put_32(header + 28, sampling_frequency * wav->channels * 2); // byte rate
+    put_16(header + 32, wav->channels * 2);                      // block align
+    put_16(header + 34, 16);                                     // bits per sample
+    header[36] = 'd', header[37] = 'a', header[38] = 't', header[39] = 'a';
+    put_32(header + 40, wav->data_size);
+
+    fwrite(header, 1, WAV_HEADER_SIZE, wav->file);
+}
+
+int wav_open(WavWriter *wav, const char *file_name, uint16_t channels, uint32_t sampling_frequency)
+{
+    wav->file = fopen(file_name, "wb");
+    if (!wav->file)
+    {
+        printf("error opening WAV file: %s\n", file_name);
+        return 0;
+    }
+
+    setvbuf(wav->file, NULL, _IOFBF, WAV_BUFFER_SIZE);
+
+    wav->channels = channels;
+    wav->data_size = 0;
+
+    write_header(wav, sampling_frequency);   // sizes are patched by wav_close
+
+    return 1;
+}
+
+// samples are written as they are in memory: WAV is little-endian like the hosts we build for
+void wav_write(WavWriter *wav, const int16_t *samples, int length)
+{
+    wav->data_size += fwrite(samples, sizeof(int16_t), length, wav->file) * sizeof(int16_t);
+}
+
+void wav_close(WavWriter *wav)
+{
+    if (!wav->file)
+        return;
+
+    uint8_t size[4];
+
+    put_32(size, WAV_HEADER_SIZE - 8 + wav->data_size);
+    fseek(wav->file, 4, SEEK_SET);
+    fwrite(size, 1, 4, wav->file);
+
+    put_32(size, wav->data_size);
+    fseek(wav->file, 40, SEEK_SET);
+    fwrite(size, 1, 4, wav->file);
+
+    fclose(wav->file);
+    wav->file = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef __WAV_H__
+#define __WAV_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+// streaming 16-bit PCM WAV writer - sizes in the header are patched when the file is closed
+
+typedef struct WavWriter
+{
+    FILE *file;
+    uint16_t channels;
+    uint32_t data_size;   // bytes of samples written so far
+} WavWriter;
+
+int wav_open(WavWriter *wav, const char *file_name, uint16_t channels, uint32_t sampling_frequency);
+void wav_write(WavWriter *wav, const int16_t *samples, int length);   // length: interleaved samples
+void wav_close(WavWriter *wav);
+
+#endif  // __WAV_H__
\ No newline at end of file